@@ -0,0 +1,178 @@
+#ifndef CONV_POOL_HPP
+#define CONV_POOL_HPP
+
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
+#include <vector>
+
+#include "mat2d.hpp"
+#include "parallel.hpp"
+#include "pooling.hpp"
+
+// Fused conv2dCPU -> maxPoolCPU / avgPoolCPU. The pooled output is produced in bands of rows;
+// each thread computes only the conv rows its band needs into a small cache-resident buffer
+// and pools them right away, so the full-resolution conv output is never allocated or written
+// back to memory. Results match calling conv2dCPU and then the pooling op.
+
+// One conv output row: out[ox] = sum over the kernel of input[oy * strideY + ky - paddingY][ox * strideX + kx - paddingX] * kernel[ky][kx].
+void conv2dRowCPU(
+    const Mat2d<float>* input,
+    const Mat2d<float>* kernel,
+    const unsigned int oy,
+    float* out,
+    const unsigned int outWidth,
+    const unsigned int* firstColumn,
+    const unsigned int* lastColumn,
+    const unsigned int strideX,
+    const unsigned int strideY,
+    const unsigned int paddingX,
+    const unsigned int paddingY) {
+  std::fill(out, out + outWidth, 0.0f);
+  for (unsigned int ky = 0; ky < kernel->height; ++ky) {
+    const unsigned int iy = oy * strideY + ky - paddingY;
+    if (iy >= input->height) {
+      continue;
+    }
+    const float* in = input->data + (size_t)iy * input->width;
+    for (unsigned int kx = 0; kx < kernel->width; ++kx) {
+      const float w = kernel->data[ky * kernel->width + kx];
+      for (unsigned int ox = firstColumn[kx]; ox < lastColumn[kx]; ++ox) {
+        out[ox] += in[ox * strideX + kx - paddingX] * w;
+      }
+    }
+  }
+}
+
+template <bool MAX>
+void conv2dPoolCPU(
+    const Mat2d<float>* input,
+    const Mat2d<float>* kernel,
+    const unsigned int poolWidth,
+    const unsigned int poolHeight,
+    Mat2d<float>* output,
+    const unsigned int convStrideX,
+    const unsigned int convStrideY,
+    const unsigned int convPaddingX,
+    const unsigned int convPaddingY,
+    const unsigned int poolStrideX,
+    const unsigned int poolStrideY,
+    const unsigned int poolPaddingX,
+    const unsigned int poolPaddingY) {
+  if (input->width < kernel->width || input->height < kernel->height) {
+    std::cout << "Input size must be greater than kernel size" << std::endl;
+    return;
+  }
+
+  if (convStrideX == 0 || convStrideY == 0 || poolStrideX == 0 || poolStrideY == 0) {
+    std::cout << "Stride must be greater than 0" << std::endl;
+    return;
+  }
+
+  const unsigned int convWidth = (input->width - kernel->width + 2 * convPaddingX) / convStrideX + 1;
+  const unsigned int convHeight = (input->height - kernel->height + 2 * convPaddingY) / convStrideY + 1;
+  if (convWidth < poolWidth || convHeight < poolHeight) {
+    std::cout << "Input size must be greater than kernel size" << std::endl;
+    return;
+  }
+
+  output->width = (convWidth - poolWidth + 2 * poolPaddingX) / poolStrideX + 1;
+  output->height = (convHeight - poolHeight + 2 * poolPaddingY) / poolStrideY + 1;
+  output->data = new float[output->width * output->height];
+  const unsigned int outWidth = output->width;
+  const unsigned int outHeight = output->height;
+
+  std::vector<unsigned int> convFirst(kernel->width), convLast(kernel->width);
+  for (unsigned int kx = 0; kx < kernel->width; ++kx) {
+    validOutputRange((long)kx - convPaddingX, input->width, convStrideX, convWidth, convFirst[kx], convLast[kx]);
+  }
+  std::vector<unsigned int> poolFirst(poolWidth), poolLast(poolWidth);
+  for (unsigned int kx = 0; kx < poolWidth; ++kx) {
+    validOutputRange((long)kx - poolPaddingX, convWidth, poolStrideX, outWidth, poolFirst[kx], poolLast[kx]);
+  }
+
+  // pooled rows per band: enough conv rows to amortize the overlap, few enough to stay in cache
+  const unsigned int BAND = std::max(1u, 32 / std::max(poolStrideY, 1u));
+  const unsigned int bands = (outHeight + BAND - 1) / BAND;
+
+  parallelFor(workerCount(bands), bands, [&](unsigned int, const size_t begin, const size_t end) {
+    std::vector<float> convRows;
+    for (size_t band = begin; band < end; ++band) {
+      const unsigned int py0 = (unsigned int)band * BAND;
+      const unsigned int py1 = std::min(outHeight, py0 + BAND);
+
+      // conv rows [cy0, cy1) cover every pooling window of the band
+      unsigned int cy0, cy1, unused;
+      clippedWindow(py0, poolStrideY, poolPaddingY, poolHeight, convHeight, cy0, unused);
+      clippedWindow(py1 - 1, poolStrideY, poolPaddingY, poolHeight, convHeight, unused, cy1);
+      convRows.resize((size_t)(cy1 - cy0) * convWidth);
+      for (unsigned int cy = cy0; cy < cy1; ++cy) {
+        conv2dRowCPU(input, kernel, cy, convRows.data() + (size_t)(cy - cy0) * convWidth, convWidth,
+                     convFirst.data(), convLast.data(), convStrideX, convStrideY, convPaddingX, convPaddingY);
+      }
+
+      for (unsigned int py = py0; py < py1; ++py) {
+        float* out = output->data + (size_t)py * outWidth;
+        std::fill(out, out + outWidth, MAX ? -FLT_MAX : 0.0f);
+        for (unsigned int ky = 0; ky < poolHeight; ++ky) {
+          const unsigned int cy = py * poolStrideY + ky - poolPaddingY;
+          if (cy >= convHeight) {
+            continue;
+          }
+          const float* in = convRows.data() + (size_t)(cy - cy0) * convWidth;
+          for (unsigned int kx = 0; kx < poolWidth; ++kx) {
+            for (unsigned int ox = poolFirst[kx]; ox < poolLast[kx]; ++ox) {
+              const float tmp = in[ox * poolStrideX + kx - poolPaddingX];
+              out[ox] = MAX ? (out[ox] > tmp ? out[ox] : tmp) : out[ox] + tmp;
+            }
+          }
+        }
+        if (!MAX) {
+          for (unsigned int ox = 0; ox < outWidth; ++ox) {
+            out[ox] /= poolWidth * poolHeight;
+          }
+        }
+      }
+    }
+  });
+}
+
+void conv2dMaxPoolCPU(
+    const Mat2d<float>* input,
+    const Mat2d<float>* kernel,
+    const unsigned int poolWidth,
+    const unsigned int poolHeight,
+    Mat2d<float>* output,
+    const unsigned int convStrideX = 1,
+    const unsigned int convStrideY = 1,
+    const unsigned int convPaddingX = 0,
+    const unsigned int convPaddingY = 0,
+    const unsigned int poolStrideX = 1,
+    const unsigned int poolStrideY = 1,
+    const unsigned int poolPaddingX = 0,
+    const unsigned int poolPaddingY = 0) {
+  conv2dPoolCPU<true>(input, kernel, poolWidth, poolHeight, output,
+                      convStrideX, convStrideY, convPaddingX, convPaddingY,
+                      poolStrideX, poolStrideY, poolPaddingX, poolPaddingY);
+}
+
+void conv2dAvgPoolCPU(
+    const Mat2d<float>* input,
+    const Mat2d<float>* kernel,
+    const unsigned int poolWidth,
+    const unsigned int poolHeight,
+    Mat2d<float>* output,
+    const unsigned int convStrideX = 1,
+    const unsigned int convStrideY = 1,
+    const unsigned int convPaddingX = 0,
+    const unsigned int convPaddingY = 0,
+    const unsigned int poolStrideX = 1,
+    const unsigned int poolStrideY = 1,
+    const unsigned int poolPaddingX = 0,
+    const unsigned int poolPaddingY = 0) {
+  conv2dPoolCPU<false>(input, kernel, poolWidth, poolHeight, output,
+                       convStrideX, convStrideY, convPaddingX, convPaddingY,
+                       poolStrideX, poolStrideY, poolPaddingX, poolPaddingY);
+}
+
+#endif // CONV_POOL_HPP
@@ -0,0 +1,384 @@
+#ifndef ELEMENTWISE_HPP
+#define ELEMENTWISE_HPP
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <iostream>
+#include <type_traits>
+
+#include "activation.hpp"
+#include "mat2d.hpp"
+#include "parallel.hpp"
+
+// Fused elementwise expressions over Mat2d<float>. Operators build a small expression tree at
+// compile time instead of computing anything; evaluateCPU then runs the whole tree in one
+// multi-threaded loop with a single write per element and no intermediate buffers:
+//
+//   Mat2d<float> out;
+//   evaluateCPU(sigmoid(fma(elementwise(&a), elementwise(&b), elementwise(&c)) * 0.5f), &out);
+//
+// Every node hands out a view of one row (row(y)), so the inner loop over x only touches row
+// pointers and scalars, and the compiler inlines and vectorizes the whole tree.
+//
+// Operands broadcast numpy-style when marked: rowVector(&v) repeats a W-vector down every row
+// (bias per column), columnVector(&v) repeats an H-vector across every column (scale per row), and
+// numbers are scalars. Each pattern has its own row view (the same row pointer for every row, or a
+// per-row scalar), so the inner loop stays a plain contiguous loop and no broadcast copy is made:
+//
+//   evaluateCPU((elementwise(&x) - columnVector(&rowMean)) * columnVector(&rowScale) + rowVector(&bias), &out);
+
+struct ElementwiseBase {};
+
+template <typename T>
+concept ElementwiseExpr = std::is_base_of_v<ElementwiseBase, std::remove_cvref_t<T>>;
+
+template <typename T>
+concept ElementwiseOperand = ElementwiseExpr<T> || std::is_arithmetic_v<std::remove_cvref_t<T>>;
+
+const unsigned int ELEMENTWISE_UNSET = UINT_MAX;
+
+// Records one dimension of the result in `dimension`, clearing ok when operands disagree on it.
+inline void matchDimension(const unsigned int size, unsigned int& dimension, bool& ok) {
+  if (dimension == ELEMENTWISE_UNSET) {
+    dimension = size;
+  } else if (dimension != size) {
+    ok = false;
+  }
+}
+
+struct ScalarRow {
+  float value;
+  float operator[](size_t) const { return value; }
+};
+
+struct PointerRow {
+  const float* data;
+  float operator[](const size_t x) const { return data[x]; }
+};
+
+struct ScalarExpr : ElementwiseBase {
+  float value;
+  ScalarRow row(size_t) const { return {value}; }
+  void shape(unsigned int&, unsigned int&, bool&) const {}
+};
+
+struct MatExpr : ElementwiseBase {
+  const float* data;
+  unsigned int width;
+  unsigned int height;
+  PointerRow row(const size_t y) const { return {data + y * width}; }
+  void shape(unsigned int& w, unsigned int& h, bool& ok) const {
+    matchDimension(width, w, ok);
+    matchDimension(height, h, ok);
+  }
+};
+
+// A vector of length width, the same for every row.
+struct RowVectorExpr : ElementwiseBase {
+  const float* data;
+  unsigned int width;
+  PointerRow row(size_t) const { return {data}; }
+  void shape(unsigned int& w, unsigned int&, bool& ok) const { matchDimension(width, w, ok); }
+};
+
+// A vector of length height: row y is data[y] in every column.
+struct ColumnVectorExpr : ElementwiseBase {
+  const float* data;
+  unsigned int height;
+  ScalarRow row(const size_t y) const { return {data[y]}; }
+  void shape(unsigned int&, unsigned int& h, bool& ok) const { matchDimension(height, h, ok); }
+};
+
+// An operand of the expression engine.
+inline MatExpr elementwise(const Mat2d<float>* m) {
+  MatExpr e;
+  e.data = m->data;
+  e.width = m->width;
+  e.height = m->height;
+  return e;
+}
+
+// v's elements (1 x W or W x 1) broadcast down the rows of the result.
+inline RowVectorExpr rowVector(const Mat2d<float>* v) {
+  RowVectorExpr e;
+  e.data = v->data;
+  e.width = v->width * v->height;
+  return e;
+}
+
+// v's elements (H x 1 or 1 x H) broadcast across the columns of the result.
+inline ColumnVectorExpr columnVector(const Mat2d<float>* v) {
+  ColumnVectorExpr e;
+  e.data = v->data;
+  e.height = v->width * v->height;
+  return e;
+}
+
+template <ElementwiseOperand T>
+auto toElementwise(const T& x) {
+  if constexpr (ElementwiseExpr<T>) {
+    return x;
+  } else {
+    ScalarExpr e;
+    e.value = (float)x;
+    return e;
+  }
+}
+
+template <typename Op, typename A>
+struct UnaryExpr : ElementwiseBase {
+  Op op;
+  A a;
+
+  struct Row {
+    Op op;
+    decltype(std::declval<A>().row(0)) a;
+    float operator[](const size_t x) const { return op(a[x]); }
+  };
+
+  Row row(const size_t y) const { return {op, a.row(y)}; }
+  void shape(unsigned int& w, unsigned int& h, bool& ok) const { a.shape(w, h, ok); }
+};
+
+template <typename Op, typename A, typename B>
+struct BinaryExpr : ElementwiseBase {
+  Op op;
+  A a;
+  B b;
+
+  struct Row {
+    Op op;
+    decltype(std::declval<A>().row(0)) a;
+    decltype(std::declval<B>().row(0)) b;
+    float operator[](const size_t x) const { return op(a[x], b[x]); }
+  };
+
+  Row row(const size_t y) const { return {op, a.row(y), b.row(y)}; }
+  void shape(unsigned int& w, unsigned int& h, bool& ok) const {
+    a.shape(w, h, ok);
+    b.shape(w, h, ok);
+  }
+};
+
+template <typename A, typename B, typename C>
+struct FmaExpr : ElementwiseBase {
+  A a;
+  B b;
+  C c;
+
+  struct Row {
+    decltype(std::declval<A>().row(0)) a;
+    decltype(std::declval<B>().row(0)) b;
+    decltype(std::declval<C>().row(0)) c;
+    // a single expression, which the compiler contracts into a fused multiply-add where it can
+    float operator[](const size_t x) const { return a[x] * b[x] + c[x]; }
+  };
+
+  Row row(const size_t y) const { return {a.row(y), b.row(y), c.row(y)}; }
+  void shape(unsigned int& w, unsigned int& h, bool& ok) const {
+    a.shape(w, h, ok);
+    b.shape(w, h, ok);
+    c.shape(w, h, ok);
+  }
+};
+
+struct AddOp {
+  float operator()(const float a, const float b) const { return a + b; }
+};
+struct SubOp {
+  float operator()(const float a, const float b) const { return a - b; }
+};
+struct MulOp {
+  float operator()(const float a, const float b) const { return a * b; }
+};
+struct DivOp {
+  float operator()(const float a, const float b) const { return a / b; }
+};
+struct MinOp {
+  float operator()(const float a, const float b) const { return b < a ? b : a; }
+};
+struct MaxOp {
+  float operator()(const float a, const float b) const { return a < b ? b : a; }
+};
+struct NegOp {
+  float operator()(const float a) const { return -a; }
+};
+struct ReluOp {
+  float operator()(const float a) const { return std::max(a, 0.0f); }
+};
+struct LeakyReluOp {
+  float alpha;
+  float operator()(const float a) const { return a < 0.0f ? alpha * a : a; }
+};
+struct Relu6Op {
+  float operator()(const float a) const { return std::min(std::max(a, 0.0f), 6.0f); }
+};
+struct SigmoidOp {
+  float operator()(const float a) const { return activationSigmoid(a); }
+};
+struct TanhOp {
+  float operator()(const float a) const { return activationTanh(a); }
+};
+struct GeluOp {
+  float operator()(const float a) const { return activationGelu(a); }
+};
+struct SiluOp {
+  float operator()(const float a) const { return activationSilu(a); }
+};
+
+template <typename Op, ElementwiseOperand A>
+auto makeUnary(const Op op, const A& a) {
+  using EA = decltype(toElementwise(a));
+  UnaryExpr<Op, EA> e;
+  e.op = op;
+  e.a = toElementwise(a);
+  return e;
+}
+
+template <typename Op, ElementwiseOperand A, ElementwiseOperand B>
+auto makeBinary(const Op op, const A& a, const B& b) {
+  using EA = decltype(toElementwise(a));
+  using EB = decltype(toElementwise(b));
+  BinaryExpr<Op, EA, EB> e;
+  e.op = op;
+  e.a = toElementwise(a);
+  e.b = toElementwise(b);
+  return e;
+}
+
+// Operators need at least one expression operand, so arithmetic on plain numbers is untouched.
+template <ElementwiseOperand A, ElementwiseOperand B>
+  requires(ElementwiseExpr<A> || ElementwiseExpr<B>)
+auto operator+(const A& a, const B& b) { return makeBinary(AddOp(), a, b); }
+
+template <ElementwiseOperand A, ElementwiseOperand B>
+  requires(ElementwiseExpr<A> || ElementwiseExpr<B>)
+auto operator-(const A& a, const B& b) { return makeBinary(SubOp(), a, b); }
+
+template <ElementwiseOperand A, ElementwiseOperand B>
+  requires(ElementwiseExpr<A> || ElementwiseExpr<B>)
+auto operator*(const A& a, const B& b) { return makeBinary(MulOp(), a, b); }
+
+template <ElementwiseOperand A, ElementwiseOperand B>
+  requires(ElementwiseExpr<A> || ElementwiseExpr<B>)
+auto operator/(const A& a, const B& b) { return makeBinary(DivOp(), a, b); }
+
+template <ElementwiseExpr A>
+auto operator-(const A& a) { return makeUnary(NegOp(), a); }
+
+template <ElementwiseOperand A, ElementwiseOperand B>
+  requires(ElementwiseExpr<A> || ElementwiseExpr<B>)
+auto min(const A& a, const B& b) { return makeBinary(MinOp(), a, b); }
+
+template <ElementwiseOperand A, ElementwiseOperand B>
+  requires(ElementwiseExpr<A> || ElementwiseExpr<B>)
+auto max(const A& a, const B& b) { return makeBinary(MaxOp(), a, b); }
+
+// a * b + c
+template <ElementwiseOperand A, ElementwiseOperand B, ElementwiseOperand C>
+  requires(ElementwiseExpr<A> || ElementwiseExpr<B> || ElementwiseExpr<C>)
+auto fma(const A& a, const B& b, const C& c) {
+  FmaExpr<decltype(toElementwise(a)), decltype(toElementwise(b)), decltype(toElementwise(c))> e;
+  e.a = toElementwise(a);
+  e.b = toElementwise(b);
+  e.c = toElementwise(c);
+  return e;
+}
+
+template <ElementwiseExpr A>
+auto relu(const A& a) { return makeUnary(ReluOp(), a); }
+
+template <ElementwiseExpr A>
+auto leakyRelu(const A& a, const float alpha = 0.01f) { return makeUnary(LeakyReluOp{alpha}, a); }
+
+template <ElementwiseExpr A>
+auto relu6(const A& a) { return makeUnary(Relu6Op(), a); }
+
+template <ElementwiseExpr A>
+auto sigmoid(const A& a) { return makeUnary(SigmoidOp(), a); }
+
+template <ElementwiseExpr A>
+auto tanh(const A& a) { return makeUnary(TanhOp(), a); }
+
+template <ElementwiseExpr A>
+auto gelu(const A& a) { return makeUnary(GeluOp(), a); }
+
+template <ElementwiseExpr A>
+auto silu(const A& a) { return makeUnary(SiluOp(), a); }
+
+// Writes expr into out (width x height), split into flat ranges across threads so a single long
+// row is parallelized too. Each element is read and written at the same index, so out may also be
+// one of the operands. An empty shape (0 x n or n x 0) writes nothing.
+template <ElementwiseExpr E>
+void evaluateRows(const E& expr, float* out, const unsigned int width, const unsigned int height) {
+  const size_t size = (size_t)width * height;
+  if (size == 0) {
+    return;
+  }
+  parallelFor(workerCount(size, 1 << 15), size, [&](unsigned int, const size_t begin, const size_t end) {
+    size_t y = begin / width;
+    size_t x = begin % width;
+    for (size_t i = begin; i < end; ++y, x = 0) {
+      const auto row = expr.row(y);
+      float* dst = out + y * width;
+      const size_t last = std::min<size_t>(width, x + (end - i));
+      for (size_t j = x; j < last; ++j) {
+        dst[j] = row[j];
+      }
+      i += last - x;
+    }
+  });
+}
+
+// Shape of the result: each dimension comes from the operands that have it (a row vector only
+// has a width, a column vector only a height) and is 1 if none does. False (with a message) if
+// there are no vector or Mat2d operands or they disagree.
+template <ElementwiseExpr E>
+bool expressionShape(const E& expr, unsigned int& width, unsigned int& height) {
+  width = ELEMENTWISE_UNSET;
+  height = ELEMENTWISE_UNSET;
+  bool ok = true;
+  expr.shape(width, height, ok);
+  if (width == ELEMENTWISE_UNSET && height == ELEMENTWISE_UNSET) {
+    std::cout << "Expression needs at least one Mat2d operand" << std::endl;
+    return false;
+  }
+  if (!ok) {
+    std::cout << "Operand shapes must match; use rowVector/columnVector to broadcast" << std::endl;
+    return false;
+  }
+  width = width == ELEMENTWISE_UNSET ? 1 : width;
+  height = height == ELEMENTWISE_UNSET ? 1 : height;
+  return true;
+}
+
+// Evaluates expr into a new output.
+template <ElementwiseExpr E>
+void evaluateCPU(const E& expr, Mat2d<float>* output) {
+  unsigned int width, height;
+  if (!expressionShape(expr, width, height)) {
+    return;
+  }
+  output->width = width;
+  output->height = height;
+  output->data = new float[(size_t)width * height];
+  evaluateRows(expr, output->data, width, height);
+}
+
+// Evaluates expr into an existing Mat2d of the same shape, which may appear in expr itself
+// (accumulate: assignCPU(elementwise(&a) + elementwise(&b), &a)).
+template <ElementwiseExpr E>
+void assignCPU(const E& expr, Mat2d<float>* target) {
+  unsigned int width, height;
+  if (!expressionShape(expr, width, height)) {
+    return;
+  }
+  if (width != target->width || height != target->height) {
+    std::cout << "Target shape must match the expression" << std::endl;
+    return;
+  }
+  evaluateRows(expr, target->data, width, height);
+}
+
+#endif // ELEMENTWISE_HPP
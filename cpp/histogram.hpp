@@ -0,0 +1,115 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "mat2d.hpp"
+#include "parallel.hpp"
+
+// Histograms of Mat2d<float> data into a bins x 1 Mat2d<uint32_t> of counts. Bins are half-open
+// [edge_i, edge_i+1) except the last, which also holds the upper edge; values outside the edges and
+// NaNs are not counted.
+//
+// Every thread counts into its own copies of the histogram. Consecutive elements go to different
+// copies, so runs of equal values (flat image regions) do not serialize on increments of the same
+// counter. Out-of-range values land in an extra sink bin instead of taking a branch.
+
+const unsigned int HISTOGRAM_COPIES = 4;
+const unsigned int HISTOGRAM_SMALL_BINS = 4096; // beyond this, collisions are rare and copies only cost cache
+
+// binOf(v) returns the bin of v, or bins for values that are not counted.
+template <typename BinOf>
+void privatizedHistogramCPU(
+    const Mat2d<float>* input,
+    const unsigned int bins,
+    BinOf binOf,
+    Mat2d<uint32_t>* output) {
+  const size_t size = (size_t)input->width * input->height;
+  const unsigned int copies = bins <= HISTOGRAM_SMALL_BINS ? HISTOGRAM_COPIES : 1;
+  const size_t stride = (size_t)bins + 1;
+  const unsigned int workers = workerCount(size, std::max<size_t>(1 << 16, stride * copies * 4));
+  std::vector<uint32_t> counts((size_t)workers * copies * stride, 0);
+
+  parallelFor(workers, size, [&](const unsigned int worker, const size_t begin, const size_t end) {
+    uint32_t* local = counts.data() + (size_t)worker * copies * stride;
+    const float* data = input->data;
+    size_t i = begin;
+    for (; i + copies <= end; i += copies) {
+      for (unsigned int c = 0; c < copies; ++c) {
+        ++local[c * stride + binOf(data[i + c])];
+      }
+    }
+    for (; i < end; ++i) {
+      ++local[binOf(data[i])];
+    }
+  });
+
+  output->width = bins;
+  output->height = 1;
+  output->data = new uint32_t[bins];
+  const size_t histograms = (size_t)workers * copies;
+  parallelFor(workerCount(bins, 4096), bins, [&](unsigned int, const size_t begin, const size_t end) {
+    for (size_t b = begin; b < end; ++b) {
+      uint32_t total = 0;
+      for (size_t h = 0; h < histograms; ++h) {
+        total += counts[h * stride + b];
+      }
+      output->data[b] = total;
+    }
+  });
+}
+
+// `bins` equal-width bins over [low, high].
+void histogramCPU(
+    const Mat2d<float>* input,
+    const unsigned int bins,
+    const float low,
+    const float high,
+    Mat2d<uint32_t>* output) {
+  if (bins == 0 || !(low < high)) {
+    std::cout << "Histogram needs at least one bin and low < high" << std::endl;
+    return;
+  }
+  const float scale = bins / (high - low);
+  privatizedHistogramCPU(input, bins, [=](const float v) -> unsigned int {
+    // NaN fails both comparisons
+    if (!(v >= low && v <= high)) {
+      return bins;
+    }
+    return std::min(bins - 1, (unsigned int)((v - low) * scale));
+  }, output);
+}
+
+// edgeCount - 1 bins with explicit, strictly increasing edges, located by binary search.
+void histogramCPU(
+    const Mat2d<float>* input,
+    const float* edges,
+    const unsigned int edgeCount,
+    Mat2d<uint32_t>* output) {
+  if (edgeCount < 2) {
+    std::cout << "Histogram needs at least two edges" << std::endl;
+    return;
+  }
+  for (unsigned int e = 1; e < edgeCount; ++e) {
+    if (!(edges[e - 1] < edges[e])) {
+      std::cout << "Histogram edges must be strictly increasing" << std::endl;
+      return;
+    }
+  }
+  const unsigned int bins = edgeCount - 1;
+  const float low = edges[0];
+  const float high = edges[bins];
+  privatizedHistogramCPU(input, bins, [=](const float v) -> unsigned int {
+    if (!(v >= low && v <= high)) {
+      return bins;
+    }
+    const unsigned int upper = (unsigned int)(std::upper_bound(edges, edges + edgeCount, v) - edges);
+    return std::min(bins, upper) - 1;
+  }, output);
+}
+
+#endif // HISTOGRAM_HPP
@@ -0,0 +1,291 @@
+#ifndef LINE_BUFFER_HPP
+#define LINE_BUFFER_HPP
+
+#include <cfloat>
+#include <cstring>
+#include <functional>
+#include <iostream>
+
+#include "mat2d.hpp"
+
+// Streaming operators for row-by-row input (line-scan cameras, decoders).
+// Each stage keeps only a kernelHeight-row ring buffer and emits an output row
+// as soon as the last input row of its window has arrived. Stages can be chained
+// (conv -> pool) so no full-frame intermediate is ever allocated.
+//
+//   LineBufferConv2d conv(&kernel, width);
+//   LineBufferMaxPool pool(2, 2, conv.outputWidth(), 2, 2);
+//   conv.connect(&pool);
+//   pool.onRow([](const float* row, unsigned int y) { ... });
+//   for (each input row) conv.pushRow(row);
+//   conv.finish();
+//
+// Output rows match conv2dCPU / maxPoolCPU / avgPoolCPU on the full frame.
+class LineBuffer {
+public:
+  virtual ~LineBuffer() {
+    delete[] ring;
+    delete[] window;
+    delete[] outRow;
+  }
+
+  LineBuffer(const LineBuffer&) = delete;
+  LineBuffer& operator=(const LineBuffer&) = delete;
+
+  unsigned int inputWidth() const { return inWidth; }
+  unsigned int outputWidth() const { return outWidth; }
+  unsigned int rowsReceived() const { return received; }
+  unsigned int rowsEmitted() const { return emitted; }
+
+  // Output rows are pushed into the next stage.
+  void connect(LineBuffer* next) {
+    if (next->inWidth != outWidth) {
+      std::cout << "Next stage input width must match output width" << std::endl;
+      return;
+    }
+    this->next = next;
+  }
+
+  // Output rows are handed to the callback. The row pointer is only valid during the call.
+  void onRow(std::function<void(const float* row, unsigned int y)> callback) {
+    this->callback = callback;
+  }
+
+  void pushRow(const float* row) {
+    if (!ring) {
+      return;
+    }
+    memcpy(ring + (size_t)(received % kerHeight) * inWidth, row, sizeof(float) * inWidth);
+    ++received;
+    // emit every output whose window ends at or before the newest row
+    while (windowTop(emitted) + (long)kerHeight <= (long)received) {
+      emitRow(received);
+    }
+  }
+
+  // Ends the frame: emits the rows that overlap the bottom padding, then finishes downstream.
+  void finish() {
+    if (!ring) {
+      return;
+    }
+    if (received < kerHeight) {
+      std::cout << "Input size must be greater than kernel size" << std::endl;
+    } else {
+      const long lastTop = (long)received - kerHeight + 2 * (long)paddingY;
+      while ((long)emitted * strideY <= lastTop) {
+        emitRow(received);
+      }
+    }
+    if (next) {
+      next->finish();
+    }
+  }
+
+  // Starts a new frame with the same configuration.
+  void reset() {
+    received = 0;
+    emitted = 0;
+    if (next) {
+      next->reset();
+    }
+  }
+
+protected:
+  LineBuffer(
+      const unsigned int inputWidth,
+      const unsigned int kernelWidth,
+      const unsigned int kernelHeight,
+      const unsigned int strideX,
+      const unsigned int strideY,
+      const unsigned int paddingX,
+      const unsigned int paddingY)
+      : inWidth(inputWidth), kerWidth(kernelWidth), kerHeight(kernelHeight),
+        strideX(strideX), strideY(strideY), paddingX(paddingX), paddingY(paddingY) {
+
+    if (inputWidth < kernelWidth || kernelHeight == 0) {
+      std::cout << "Input size must be greater than kernel size" << std::endl;
+      return;
+    }
+
+    if (strideX == 0 || strideY == 0) {
+      std::cout << "Stride must be greater than 0" << std::endl;
+      return;
+    }
+
+    outWidth = (inputWidth - kernelWidth + 2 * paddingX) / strideX + 1;
+    ring = new float[(size_t)kernelHeight * inputWidth];
+    window = new const float*[kernelHeight];
+    outRow = new float[outWidth];
+  }
+
+  // Computes one output row. rows[ky] is nullptr where the window overlaps vertical padding.
+  virtual void computeRow(const float* const* rows, float* out) = 0;
+
+  // Output columns [first, last) whose input column ox * strideX + kx - paddingX is inside the row.
+  void validColumns(const unsigned int kx, unsigned int& first, unsigned int& last) const {
+    const long offset = (long)kx - paddingX;
+    first = offset >= 0 ? 0 : (unsigned int)((-offset + strideX - 1) / strideX);
+    const long end = (long)inWidth - 1 - offset;
+    last = end < 0 ? 0 : (unsigned int)(end / strideX + 1);
+    if (last > outWidth) {
+      last = outWidth;
+    }
+    if (first > last) {
+      first = last;
+    }
+  }
+
+  const unsigned int inWidth;
+  const unsigned int kerWidth;
+  const unsigned int kerHeight;
+  const unsigned int strideX;
+  const unsigned int strideY;
+  const unsigned int paddingX;
+  const unsigned int paddingY;
+  unsigned int outWidth = 0;
+
+private:
+  long windowTop(const unsigned int oy) const {
+    return (long)oy * strideY - paddingY;
+  }
+
+  // rowCount is the number of input rows known to exist; rows past it are bottom padding.
+  void emitRow(const unsigned int rowCount) {
+    const long top = windowTop(emitted);
+    for (unsigned int ky = 0; ky < kerHeight; ++ky) {
+      const long iy = top + ky;
+      window[ky] = iy < 0 || iy >= (long)rowCount ? nullptr : ring + (size_t)(iy % kerHeight) * inWidth;
+    }
+    computeRow(window, outRow);
+    if (next) {
+      next->pushRow(outRow);
+    }
+    if (callback) {
+      callback(outRow, emitted);
+    }
+    ++emitted;
+  }
+
+  float* ring = nullptr;
+  const float** window = nullptr;
+  float* outRow = nullptr;
+  unsigned int received = 0;
+  unsigned int emitted = 0;
+  LineBuffer* next = nullptr;
+  std::function<void(const float*, unsigned int)> callback;
+};
+
+class LineBufferConv2d : public LineBuffer {
+public:
+  LineBufferConv2d(
+      const Mat2d<float>* kernel,
+      const unsigned int inputWidth,
+      const unsigned int strideX = 1,
+      const unsigned int strideY = 1,
+      const unsigned int paddingX = 0,
+      const unsigned int paddingY = 0)
+      : LineBuffer(inputWidth, kernel->width, kernel->height, strideX, strideY, paddingX, paddingY) {
+    weights = new float[kernel->width * kernel->height];
+    memcpy(weights, kernel->data, sizeof(float) * kernel->width * kernel->height);
+  }
+
+  ~LineBufferConv2d() {
+    delete[] weights;
+  }
+
+protected:
+  void computeRow(const float* const* rows, float* out) override {
+    for (unsigned int ox = 0; ox < outWidth; ++ox) {
+      out[ox] = 0.0f;
+    }
+    for (unsigned int ky = 0; ky < kerHeight; ++ky) {
+      if (!rows[ky]) {
+        continue;
+      }
+      for (unsigned int kx = 0; kx < kerWidth; ++kx) {
+        const float w = weights[ky * kerWidth + kx];
+        const float* in = rows[ky];
+        unsigned int first, last;
+        validColumns(kx, first, last);
+        for (unsigned int ox = first; ox < last; ++ox) {
+          out[ox] += in[ox * strideX + kx - paddingX] * w;
+        }
+      }
+    }
+  }
+
+private:
+  float* weights;
+};
+
+class LineBufferMaxPool : public LineBuffer {
+public:
+  LineBufferMaxPool(
+      const unsigned int kernelWidth,
+      const unsigned int kernelHeight,
+      const unsigned int inputWidth,
+      const unsigned int strideX = 1,
+      const unsigned int strideY = 1,
+      const unsigned int paddingX = 0,
+      const unsigned int paddingY = 0)
+      : LineBuffer(inputWidth, kernelWidth, kernelHeight, strideX, strideY, paddingX, paddingY) {}
+
+protected:
+  void computeRow(const float* const* rows, float* out) override {
+    for (unsigned int ox = 0; ox < outWidth; ++ox) {
+      out[ox] = -FLT_MAX;
+    }
+    for (unsigned int ky = 0; ky < kerHeight; ++ky) {
+      if (!rows[ky]) {
+        continue;
+      }
+      for (unsigned int kx = 0; kx < kerWidth; ++kx) {
+        const float* in = rows[ky];
+        unsigned int first, last;
+        validColumns(kx, first, last);
+        for (unsigned int ox = first; ox < last; ++ox) {
+          const float tmp = in[ox * strideX + kx - paddingX];
+          out[ox] = out[ox] > tmp ? out[ox] : tmp;
+        }
+      }
+    }
+  }
+};
+
+class LineBufferAvgPool : public LineBuffer {
+public:
+  LineBufferAvgPool(
+      const unsigned int kernelWidth,
+      const unsigned int kernelHeight,
+      const unsigned int inputWidth,
+      const unsigned int strideX = 1,
+      const unsigned int strideY = 1,
+      const unsigned int paddingX = 0,
+      const unsigned int paddingY = 0)
+      : LineBuffer(inputWidth, kernelWidth, kernelHeight, strideX, strideY, paddingX, paddingY) {}
+
+protected:
+  void computeRow(const float* const* rows, float* out) override {
+    for (unsigned int ox = 0; ox < outWidth; ++ox) {
+      out[ox] = 0.0f;
+    }
+    for (unsigned int ky = 0; ky < kerHeight; ++ky) {
+      if (!rows[ky]) {
+        continue;
+      }
+      for (unsigned int kx = 0; kx < kerWidth; ++kx) {
+        const float* in = rows[ky];
+        unsigned int first, last;
+        validColumns(kx, first, last);
+        for (unsigned int ox = first; ox < last; ++ox) {
+          out[ox] += in[ox * strideX + kx - paddingX];
+        }
+      }
+    }
+    for (unsigned int ox = 0; ox < outWidth; ++ox) {
+      out[ox] /= kerWidth * kerHeight;
+    }
+  }
+};
+
+#endif // LINE_BUFFER_HPP
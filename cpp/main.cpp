@@ -1,5 +1,8 @@
 #include "metal-conv.hpp"
 #include "benchmark.hpp"
+#include "conv-pool.hpp"
+#include "line-buffer.hpp"
+#include "pooling.hpp"
 #include <iostream>
 
 void randomMat2d(Mat2d<float>* mat, unsigned int width, unsigned int height) {
@@ -77,6 +80,12 @@ int main() {
     // printOutput(output);
     delete[] output.data;
 
+    Benchmark benchMaxPoolSeparableCPU("MaxPool separable CPU");
+    maxPoolSeparableCPU(&input, POOL_SIZE, POOL_SIZE, &output);
+    benchMaxPoolSeparableCPU.stop();
+    // printOutput(output);
+    delete[] output.data;
+
     printf("AvgPool kernel: %d x %d\n", POOL_SIZE, POOL_SIZE);
     Benchmark benchAvgPoolGPU("AvgPool GPU");
     metalConv->avgPool(&input, POOL_SIZE, POOL_SIZE, &output);
@@ -89,6 +98,28 @@ int main() {
     // printOutput(output);
     delete[] output.data;
 
+    Benchmark benchAvgPoolIntegralCPU("AvgPool integral CPU");
+    avgPoolIntegralCPU(&input, POOL_SIZE, POOL_SIZE, &output);
+    benchAvgPoolIntegralCPU.stop();
+    // printOutput(output);
+    delete[] output.data;
+
+    Benchmark benchLineBufferCPU("Conv2d+MaxPool line buffer CPU");
+    LineBufferConv2d lineConv(&kernel, input.width);
+    LineBufferMaxPool linePool(POOL_SIZE, POOL_SIZE, lineConv.outputWidth());
+    lineConv.connect(&linePool);
+    for (unsigned int y = 0; y < input.height; ++y) {
+      lineConv.pushRow(input.data + y * input.width);
+    }
+    lineConv.finish();
+    benchLineBufferCPU.stop();
+
+    Benchmark benchConv2dMaxPoolCPU("Conv2d+MaxPool fused CPU");
+    conv2dMaxPoolCPU(&input, &kernel, POOL_SIZE, POOL_SIZE, &output);
+    benchConv2dMaxPoolCPU.stop();
+    // printOutput(output);
+    delete[] output.data;
+
 
     // Benchmark benchReduce;
     // const float f = metalConv->reduceSum(&input2, 256);
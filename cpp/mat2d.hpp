@@ -0,0 +1,11 @@
+#ifndef MAT2D_HPP
+#define MAT2D_HPP
+
+template <typename T>
+struct Mat2d {
+  T* data;
+  unsigned int width;
+  unsigned int height;
+};
+
+#endif // MAT2D_HPP
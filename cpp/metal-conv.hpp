@@ -9,8 +9,14 @@
 #include <Metal/Metal.hpp>
 #include <QuartzCore/QuartzCore.hpp>
 
+#include <cstring>
 #include <iostream>
 
+#include "activation.hpp"
+#include "mat2d.hpp"
+#include "pooling.hpp"
+#include "reduce.hpp"
+
 void handleErrors(void* data, NS::Error* pError) {
   if (!data && pError) {
     printf("%s", pError->localizedDescription()->utf8String());
@@ -21,13 +27,6 @@ void handleErrors(void* data, NS::Error* pError) {
 // const char* kernelSrc = R"(
 // )";
 
-template <typename T>
-struct Mat2d {
-  T* data;
-  unsigned int width;
-  unsigned int height;
-};
-
 class MetalConv {
 public:
   MetalConv();
@@ -94,11 +93,15 @@ public:
       const Mat2d<float>* input,
       Mat2d<float>* output);
 
+  void reluCPU(
+      const Mat2d<float>* input,
+      Mat2d<float>* output);
+
   double reduceSum(
       const Mat2d<float>* input,
       const unsigned int width);
 
-  double reduceSumCPU(const Mat2d<float>* input);
+  double reduceSumCPU(const Mat2d<float>* input, const ReduceMode mode = ReduceMode::Fast);
 
 private:
   NS::AutoreleasePool* pPool;
@@ -108,10 +111,12 @@ private:
   MTL::Function* pFunctionMaxPool;
   MTL::Function* pFunctionAvgPool;
   MTL::Function* pFunctionReduce;
+  MTL::Function* pFunctionRelu;
   MTL::ComputePipelineState* pComputePipelineStateConv2d;
   MTL::ComputePipelineState* pComputePipelineStateMaxPool;
   MTL::ComputePipelineState* pComputePipelineStateAvgPool;
   MTL::ComputePipelineState* pComputePipelineStateReduce;
+  MTL::ComputePipelineState* pComputePipelineStateRelu;
   MTL::CommandQueue* pCommandQueue;
 };
 
@@ -121,10 +126,12 @@ MetalConv::~MetalConv() {
   pComputePipelineStateMaxPool->release();
   pComputePipelineStateAvgPool->release();
   pComputePipelineStateReduce->release();
+  pComputePipelineStateRelu->release();
   pFunctionConv2d->release();
   pFunctionMaxPool->release();
   pFunctionAvgPool->release();
   pFunctionReduce->release();
+  pFunctionRelu->release();
   pLibrary->release();
   pDevice->release();
   pPool->release();
@@ -156,6 +163,10 @@ MetalConv::MetalConv() {
   pComputePipelineStateReduce = pDevice->newComputePipelineState(pFunctionReduce, &pError);
   handleErrors(pComputePipelineStateReduce, pError);
 
+  pFunctionRelu = pLibrary->newFunction(NS::String::string("relu", NS::UTF8StringEncoding));
+  pComputePipelineStateRelu = pDevice->newComputePipelineState(pFunctionRelu, &pError);
+  handleErrors(pComputePipelineStateRelu, pError);
+
   pCommandQueue = pDevice->newCommandQueue();
 }
 
@@ -369,11 +380,12 @@ double MetalConv::reduceSum(
     const Mat2d<float>* input,
     const unsigned int width) {
 
+  const unsigned int length = input->width * input->height;
   Mat2d<float> output;
-  output.width = input->width % width == 0 ? input->width / width : input->width / width + 1;
+  output.width = length % width == 0 ? length / width : length / width + 1;
   output.height = 1;
 
-  if (input->width <= 32) {
+  if (length <= 32) {
     return reduceSumCPU(input);
   }
 
@@ -381,10 +393,10 @@ double MetalConv::reduceSum(
   MTL::ComputeCommandEncoder* pComputeCommandEncoder = pCommandBuffer->computeCommandEncoder();
   pComputeCommandEncoder->setComputePipelineState(pComputePipelineStateReduce);
 
-  MTL::Buffer* inputBuffer = pDevice->newBuffer(input->data, sizeof(float) * input->width, MTL::ResourceStorageModeShared);
+  MTL::Buffer* inputBuffer = pDevice->newBuffer(input->data, sizeof(float) * length, MTL::ResourceStorageModeShared);
   MTL::Buffer* outputBuffer = pDevice->newBuffer(sizeof(float) * output.width, MTL::ResourceStorageModeShared);
   pComputeCommandEncoder->setBuffer(inputBuffer, 0, 0);
-  pComputeCommandEncoder->setBytes(&input->width, sizeof(unsigned int), 1);
+  pComputeCommandEncoder->setBytes(&length, sizeof(unsigned int), 1);
   pComputeCommandEncoder->setBytes(&width, sizeof(unsigned int), 2);
 
   pComputeCommandEncoder->setBuffer(outputBuffer, 0, 3);
@@ -505,6 +517,12 @@ void MetalConv::avgPoolCPU(
 
   output->width = (input->width - kernelWidth + 2 * paddingX) / strideX + 1;
   output->height = (input->height - kernelHeight + 2 * paddingY) / strideY + 1;
+
+  if ((size_t)kernelWidth * kernelHeight * output->width * output->height >= (size_t)AVG_POOL_INTEGRAL_CROSSOVER * input->width * input->height) {
+    avgPoolIntegralCPU(input, kernelWidth, kernelHeight, output, strideX, strideY, paddingX, paddingY);
+    return;
+  }
+
   output->data = new float[output->width * output->height];
 
   for (unsigned int oy = 0; oy < output->height; ++oy) {
@@ -529,17 +547,42 @@ void MetalConv::relu(
     Mat2d<float>* output) {
   output->width = input->width;
   output->height = input->height;
-  output->data = new float[output->width * output->height];
+  const unsigned int length = output->width * output->height;
+
+  MTL::CommandBuffer* pCommandBuffer = pCommandQueue->commandBuffer();
+  MTL::ComputeCommandEncoder* pComputeCommandEncoder = pCommandBuffer->computeCommandEncoder();
+  pComputeCommandEncoder->setComputePipelineState(pComputePipelineStateRelu);
 
+  MTL::Buffer* inputBuffer = pDevice->newBuffer(input->data, sizeof(float) * length, MTL::ResourceStorageModeShared);
+  MTL::Buffer* outputBuffer = pDevice->newBuffer(sizeof(float) * length, MTL::ResourceStorageModeShared);
+  pComputeCommandEncoder->setBuffer(inputBuffer, 0, 0);
+  pComputeCommandEncoder->setBuffer(outputBuffer, 0, 1);
+
+  MTL::Size gridSize = MTL::Size(length, 1, 1);
+  NS::UInteger maxTotalThreadsPerThreadgroup = pComputePipelineStateRelu->maxTotalThreadsPerThreadgroup();
+  MTL::Size threadgroupSize(maxTotalThreadsPerThreadgroup, 1, 1);
+  pComputeCommandEncoder->dispatchThreads(gridSize, threadgroupSize);
+  pComputeCommandEncoder->endEncoding();
+
+  pCommandBuffer->commit();
+  pCommandBuffer->waitUntilCompleted();
 
+  // copied out so the output outlives the buffer and is released with delete[] like the CPU ops'
+  output->data = new float[length];
+  memcpy(output->data, outputBuffer->contents(), sizeof(float) * length);
+
+  inputBuffer->release();
+  outputBuffer->release();
 }
 
-double MetalConv::reduceSumCPU(const Mat2d<float>* input) {
-  double sum = 0.0f;
-  for (unsigned int i = 0; i < input->width; ++i) {
-    sum += input->data[i];
-  }
-  return sum;
+void MetalConv::reluCPU(
+    const Mat2d<float>* input,
+    Mat2d<float>* output) {
+  activationCPU(input, Activation::ReLU, output);
+}
+
+double MetalConv::reduceSumCPU(const Mat2d<float>* input, const ReduceMode mode) {
+  return reduceSumRangeCPU(input->data, (size_t)input->width * input->height, mode);
 }
 
 #endif // METAL_CONV_HPP
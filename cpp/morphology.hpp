@@ -0,0 +1,207 @@
+#ifndef MORPHOLOGY_HPP
+#define MORPHOLOGY_HPP
+
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
+#include <vector>
+
+#include "mat2d.hpp"
+#include "parallel.hpp"
+#include "pooling.hpp"
+
+// Grayscale morphology with arbitrary structuring elements. A mask element is part of the
+// structuring element when it is non-zero; the anchor is the mask center (width / 2, height / 2)
+// and out[y][x] = max (or min) of in[y + my - height / 2][x + mx - width / 2] over the mask,
+// ignoring positions outside the input. Output has the input size. Opening and closing undo their
+// first step with the reflected mask, so they stay anti-extensive / extensive (opening <= input
+// <= closing) for asymmetric and even-size masks too.
+//
+// The mask is decomposed into horizontal runs. For every distinct run length a van Herk/Gil-Werman
+// sliding max of the input rows is computed once, after which each run costs one lookup per
+// pixel, so the cost follows the number of runs (the mask outline) rather than its area.
+
+void diskMask(const unsigned int radius, Mat2d<float>* mask) {
+  mask->width = 2 * radius + 1;
+  mask->height = 2 * radius + 1;
+  mask->data = new float[mask->width * mask->height];
+  for (unsigned int y = 0; y < mask->height; ++y) {
+    for (unsigned int x = 0; x < mask->width; ++x) {
+      const long dx = (long)x - radius;
+      const long dy = (long)y - radius;
+      mask->data[y * mask->width + x] = dx * dx + dy * dy <= (long)radius * radius ? 1.0f : 0.0f;
+    }
+  }
+}
+
+void crossMask(const unsigned int radius, Mat2d<float>* mask) {
+  mask->width = 2 * radius + 1;
+  mask->height = 2 * radius + 1;
+  mask->data = new float[mask->width * mask->height];
+  for (unsigned int y = 0; y < mask->height; ++y) {
+    for (unsigned int x = 0; x < mask->width; ++x) {
+      mask->data[y * mask->width + x] = x == radius || y == radius ? 1.0f : 0.0f;
+    }
+  }
+}
+
+// The mask rotated by 180 degrees, which moves the anchor (ax, ay) to (width - 1 - ax, height - 1 - ay).
+void reflectMask(const Mat2d<float>* mask, Mat2d<float>* reflected) {
+  const size_t size = (size_t)mask->width * mask->height;
+  reflected->width = mask->width;
+  reflected->height = mask->height;
+  reflected->data = new float[size];
+  std::reverse_copy(mask->data, mask->data + size, reflected->data);
+}
+
+// Dilation when negate is false; erosion as -dilate(-input) when it is true (negation is exact).
+// out[y][x] covers in[y + my - anchorY][x + mx - anchorX].
+void morphologyCPU(
+    const Mat2d<float>* input,
+    const Mat2d<float>* mask,
+    Mat2d<float>* output,
+    const bool negate,
+    const unsigned int anchorX,
+    const unsigned int anchorY) {
+  struct Run {
+    unsigned int row;
+    unsigned int start;
+    unsigned int length;
+    unsigned int lengthIndex;
+  };
+
+  std::vector<Run> runs;
+  std::vector<unsigned int> lengths;
+  for (unsigned int my = 0; my < mask->height; ++my) {
+    const float* m = mask->data + my * mask->width;
+    for (unsigned int mx = 0; mx < mask->width;) {
+      if (m[mx] == 0.0f) {
+        ++mx;
+        continue;
+      }
+      const unsigned int start = mx;
+      while (mx < mask->width && m[mx] != 0.0f) {
+        ++mx;
+      }
+      const unsigned int length = mx - start;
+      const unsigned int lengthIndex = std::find(lengths.begin(), lengths.end(), length) - lengths.begin();
+      if (lengthIndex == lengths.size()) {
+        lengths.push_back(length);
+      }
+      runs.push_back({my, start, length, lengthIndex});
+    }
+  }
+
+  if (runs.empty()) {
+    std::cout << "Mask must contain at least one non-zero element" << std::endl;
+    return;
+  }
+
+  const unsigned int width = input->width;
+  const unsigned int height = input->height;
+  output->width = width;
+  output->height = height;
+  output->data = new float[width * height];
+
+  // window starts p = x + start for x in [0, width), i.e. padded line positions q = p + k, input x = q - anchorX
+  const unsigned int starts = width + mask->width - 1;
+  const unsigned int BAND = 64;
+  const unsigned int bands = (height + BAND - 1) / BAND;
+
+  parallelFor(workerCount(bands), bands, [&](unsigned int, const size_t begin, const size_t end) {
+    std::vector<float> suffix(starts + mask->width);
+    std::vector<std::vector<float>> slidingMax(lengths.size());
+    for (size_t band = begin; band < end; ++band) {
+      const unsigned int y0 = (unsigned int)band * BAND;
+      const unsigned int y1 = std::min(height, y0 + BAND);
+      const long firstRow = std::max(0l, (long)y0 - anchorY);
+      const long lastRow = std::min((long)height, (long)y1 + mask->height - 1 - anchorY);
+      const size_t rows = lastRow - firstRow;
+
+      for (size_t li = 0; li < lengths.size(); ++li) {
+        slidingMax[li].resize(rows * starts);
+        for (size_t r = 0; r < rows; ++r) {
+          const float* in = input->data + (firstRow + r) * width;
+          float* out = slidingMax[li].data() + r * starts;
+          slidingMaxLine(
+              lengths[li], 1, starts, suffix.data(),
+              [=](const unsigned int q) {
+                const unsigned int x = q - anchorX;
+                return x < width ? (negate ? -in[x] : in[x]) : -FLT_MAX;
+              },
+              [=](const unsigned int p, const float max) { out[p] = max; });
+        }
+      }
+
+      for (unsigned int y = y0; y < y1; ++y) {
+        float* out = output->data + (size_t)y * width;
+        std::fill(out, out + width, -FLT_MAX);
+        for (const Run& run : runs) {
+          const long iy = (long)y + run.row - anchorY;
+          if (iy < firstRow || iy >= lastRow) {
+            continue;
+          }
+          const float* src = slidingMax[run.lengthIndex].data() + (iy - firstRow) * starts + run.start;
+          for (unsigned int x = 0; x < width; ++x) {
+            out[x] = std::max(out[x], src[x]);
+          }
+        }
+        if (negate) {
+          for (unsigned int x = 0; x < width; ++x) {
+            out[x] = -out[x];
+          }
+        }
+      }
+    }
+  });
+}
+
+void dilateCPU(
+    const Mat2d<float>* input,
+    const Mat2d<float>* mask,
+    Mat2d<float>* output) {
+  morphologyCPU(input, mask, output, false, mask->width / 2, mask->height / 2);
+}
+
+void erodeCPU(
+    const Mat2d<float>* input,
+    const Mat2d<float>* mask,
+    Mat2d<float>* output) {
+  morphologyCPU(input, mask, output, true, mask->width / 2, mask->height / 2);
+}
+
+// Erosion followed by dilation: removes bright details smaller than the structuring element.
+void openingCPU(
+    const Mat2d<float>* input,
+    const Mat2d<float>* mask,
+    Mat2d<float>* output) {
+  Mat2d<float> eroded = {nullptr, 0, 0};
+  erodeCPU(input, mask, &eroded);
+  if (!eroded.data) {
+    return;
+  }
+  Mat2d<float> reflected;
+  reflectMask(mask, &reflected);
+  morphologyCPU(&eroded, &reflected, output, false, mask->width - 1 - mask->width / 2, mask->height - 1 - mask->height / 2);
+  delete[] reflected.data;
+  delete[] eroded.data;
+}
+
+// Dilation followed by erosion: fills dark details smaller than the structuring element.
+void closingCPU(
+    const Mat2d<float>* input,
+    const Mat2d<float>* mask,
+    Mat2d<float>* output) {
+  Mat2d<float> dilated = {nullptr, 0, 0};
+  dilateCPU(input, mask, &dilated);
+  if (!dilated.data) {
+    return;
+  }
+  Mat2d<float> reflected;
+  reflectMask(mask, &reflected);
+  morphologyCPU(&dilated, &reflected, output, true, mask->width - 1 - mask->width / 2, mask->height - 1 - mask->height / 2);
+  delete[] reflected.data;
+  delete[] dilated.data;
+}
+
+#endif // MORPHOLOGY_HPP
@@ -0,0 +1,147 @@
+#ifndef NORMALIZATION_HPP
+#define NORMALIZATION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+#include "elementwise.hpp"
+#include "mat2d.hpp"
+#include "parallel.hpp"
+
+// Inference-time normalization: batch-norm folding into conv weights, and fused LayerNorm and
+// BatchNorm operators that read the input once.
+
+// Batch-norm parameters of one channel: y = gamma * (x - mean) / sqrt(variance + epsilon) + beta.
+struct BatchNormParams {
+  float gamma;
+  float beta;
+  float mean;
+  float variance;
+  float epsilon = 1e-5f;
+};
+
+// Folds a batch norm that follows a conv (kernel plus a scalar bias) into the conv itself, in place:
+// bn(conv(x, kernel) + bias) == conv(x, kernel') + bias'. conv2dCPU has no bias term, so add it
+// to the output in the same pass as anything that follows, e.g.
+// assignCPU(relu(elementwise(&out) + bias), &out).
+void foldBatchNorm(Mat2d<float>* kernel, float* bias, const BatchNormParams& bn) {
+  const double scale = bn.gamma / std::sqrt((double)bn.variance + bn.epsilon);
+  const size_t size = (size_t)kernel->width * kernel->height;
+  for (size_t i = 0; i < size; ++i) {
+    kernel->data[i] = (float)(kernel->data[i] * scale);
+  }
+  *bias = (float)((*bias - (double)bn.mean) * scale + bn.beta);
+}
+
+// One (kernel, bias) pair per output channel.
+void foldBatchNorm(Mat2d<float>* kernels, float* biases, const BatchNormParams* bn, const unsigned int channels) {
+  for (unsigned int c = 0; c < channels; ++c) {
+    foldBatchNorm(&kernels[c], &biases[c], bn[c]);
+  }
+}
+
+// Batch norm of a single channel (e.g. one conv feature map): one fused multiply-add pass.
+void batchNormCPU(const Mat2d<float>* input, const BatchNormParams& bn, Mat2d<float>* output) {
+  const double scale = bn.gamma / std::sqrt((double)bn.variance + bn.epsilon);
+  const float shift = (float)(bn.beta - bn.mean * scale);
+  evaluateCPU(fma(elementwise(input), (float)scale, shift), output);
+}
+
+// Batch norm of a feature matrix: rows are samples, column x is feature x with parameters
+// features[x]. The per-feature scale and shift are broadcast down the rows in one fused pass.
+void batchNormFeaturesCPU(const Mat2d<float>* input, const BatchNormParams* features, Mat2d<float>* output) {
+  std::vector<float> scale(input->width), shift(input->width);
+  for (unsigned int x = 0; x < input->width; ++x) {
+    const BatchNormParams& bn = features[x];
+    const double s = bn.gamma / std::sqrt((double)bn.variance + bn.epsilon);
+    scale[x] = (float)s;
+    shift[x] = (float)(bn.beta - bn.mean * s);
+  }
+  const Mat2d<float> scaleRow = {scale.data(), input->width, 1};
+  const Mat2d<float> shiftRow = {shift.data(), input->width, 1};
+  evaluateCPU(fma(elementwise(input), rowVector(&scaleRow), rowVector(&shiftRow)), output);
+}
+
+// Normalizes one row with its population mean and variance, then applies gamma/beta per column.
+// The statistics are a single sweep of sums and squared sums in double around the row's first
+// element (which keeps the cancellation in sumSquares - sum^2 / n small); the normalizing sweep
+// then reads the row again while it is still in cache.
+template <bool AFFINE>
+void layerNormRow(const float* in, float* out, const unsigned int width, const float* gamma, const float* beta, const float epsilon) {
+  const unsigned int LANES = 8;
+  const double pivot = in[0];
+  double sums[LANES] = {}, squares[LANES] = {};
+  unsigned int i = 0;
+  for (; i + LANES <= width; i += LANES) {
+    for (unsigned int l = 0; l < LANES; ++l) {
+      const double d = in[i + l] - pivot;
+      sums[l] += d;
+      squares[l] += d * d;
+    }
+  }
+  for (unsigned int l = 0; i < width; ++i, ++l) {
+    const double d = in[i] - pivot;
+    sums[l] += d;
+    squares[l] += d * d;
+  }
+  double sum = 0.0, square = 0.0;
+  for (unsigned int l = 0; l < LANES; ++l) {
+    sum += sums[l];
+    square += squares[l];
+  }
+  const double shiftedMean = sum / width;
+  const double variance = std::max(0.0, square / width - shiftedMean * shiftedMean);
+  const float rstd = (float)(1.0 / std::sqrt(variance + epsilon));
+  // the mean is subtracted before scaling, as a float pair hi + lo: in[x] - hi is exact when in[x]
+  // is close to the mean, which is exactly when folding the mean into an offset would cancel
+  const double mean = pivot + shiftedMean;
+  const float meanHi = (float)mean;
+  const float meanLo = (float)(mean - meanHi);
+  for (unsigned int x = 0; x < width; ++x) {
+    const float normalized = ((in[x] - meanHi) - meanLo) * rstd;
+    if constexpr (AFFINE) {
+      out[x] = normalized * gamma[x] + beta[x];
+    } else {
+      out[x] = normalized;
+    }
+  }
+}
+
+// Layer norm over each row (the features of one sample). gamma and beta have width entries, or
+// are both null for a plain normalization. Rows are split across threads.
+void layerNormCPU(
+    const Mat2d<float>* input,
+    const float* gamma,
+    const float* beta,
+    Mat2d<float>* output,
+    const float epsilon = 1e-5f) {
+  const unsigned int width = input->width;
+  const unsigned int height = input->height;
+  if (width == 0 || height == 0) {
+    std::cout << "Input must not be empty" << std::endl;
+    return;
+  }
+  if ((gamma == nullptr) != (beta == nullptr)) {
+    std::cout << "Gamma and beta must both be given or both be null" << std::endl;
+    return;
+  }
+  output->width = width;
+  output->height = height;
+  output->data = new float[(size_t)width * height];
+  parallelFor(workerCount((size_t)width * height, 1 << 15), height, [&](unsigned int, const size_t begin, const size_t end) {
+    for (size_t y = begin; y < end; ++y) {
+      const float* in = input->data + y * width;
+      float* out = output->data + y * width;
+      if (gamma) {
+        layerNormRow<true>(in, out, width, gamma, beta, epsilon);
+      } else {
+        layerNormRow<false>(in, out, width, gamma, beta, epsilon);
+      }
+    }
+  });
+}
+
+#endif // NORMALIZATION_HPP
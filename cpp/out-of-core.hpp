@@ -0,0 +1,325 @@
+#ifndef OUT_OF_CORE_HPP
+#define OUT_OF_CORE_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cfloat>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include "conv-pool.hpp"
+#include "mat2d.hpp"
+#include "parallel.hpp"
+#include "pooling.hpp"
+
+// Raw row-major float32 image file mapped into memory. Pages are loaded on demand and are
+// reclaimable by the OS, so the image itself never has to fit in RAM.
+class MappedMat2d {
+public:
+  MappedMat2d() {}
+  ~MappedMat2d() { close(); }
+
+  MappedMat2d(const MappedMat2d&) = delete;
+  MappedMat2d& operator=(const MappedMat2d&) = delete;
+
+  bool openRead(const char* path, const unsigned int width, const unsigned int height) {
+    return map(path, width, height, false);
+  }
+
+  // Creates (or truncates) the file and sizes it to width x height floats.
+  bool create(const char* path, const unsigned int width, const unsigned int height) {
+    return map(path, width, height, true);
+  }
+
+  void close() {
+    if (mat.data) {
+      munmap(mat.data, bytes());
+      mat.data = nullptr;
+    }
+    if (fd >= 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+
+  // Writes back rows [firstRow, lastRow) and lets the OS drop them; they are re-read from the file if touched again.
+  void releaseRows(const unsigned int firstRow, const unsigned int lastRow) {
+    char* begin;
+    size_t length;
+    if (pageRange(firstRow, lastRow, begin, length)) {
+      if (writable) {
+        msync(begin, length, MS_SYNC);
+      }
+      madvise(begin, length, MADV_DONTNEED);
+    }
+  }
+
+  Mat2d<float> mat = {nullptr, 0, 0};
+
+private:
+  size_t bytes() const {
+    return sizeof(float) * (size_t)mat.width * mat.height;
+  }
+
+  bool map(const char* path, const unsigned int width, const unsigned int height, const bool write) {
+    close();
+    mat.width = width;
+    mat.height = height;
+    writable = write;
+
+    fd = write ? ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644) : ::open(path, O_RDONLY);
+    if (fd < 0) {
+      std::cout << "Failed to open " << path << std::endl;
+      return false;
+    }
+    if (write && ftruncate(fd, bytes()) != 0) {
+      std::cout << "Failed to resize " << path << std::endl;
+      close();
+      return false;
+    }
+    if (!write && lseek(fd, 0, SEEK_END) < (off_t)bytes()) {
+      std::cout << path << " is smaller than " << width << " x " << height << " floats" << std::endl;
+      close();
+      return false;
+    }
+
+    void* data = mmap(nullptr, bytes(), write ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+      std::cout << "Failed to map " << path << std::endl;
+      close();
+      return false;
+    }
+    mat.data = (float*)data;
+    return true;
+  }
+
+  // Page-aligned span fully covered by rows [firstRow, lastRow).
+  bool pageRange(const unsigned int firstRow, const unsigned int lastRow, char*& begin, size_t& length) const {
+    if (!mat.data || firstRow >= lastRow) {
+      return false;
+    }
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t from = sizeof(float) * (size_t)firstRow * mat.width;
+    size_t to = sizeof(float) * (size_t)std::min(lastRow, mat.height) * mat.width;
+    from = (from + page - 1) / page * page;
+    to = lastRow >= mat.height ? (to + page - 1) / page * page : to / page * page;
+    if (from >= to) {
+      return false;
+    }
+    begin = (char*)mat.data + from;
+    length = to - from;
+    return true;
+  }
+
+  int fd = -1;
+  bool writable = false;
+};
+
+// A CPU engine applied to one halo-extended tile. The tile already contains its padding
+// (filled with padValue), so `run` is called with the op's stride and no padding.
+struct TileOp {
+  unsigned int kernelWidth;
+  unsigned int kernelHeight;
+  unsigned int strideX;
+  unsigned int strideY;
+  unsigned int paddingX;
+  unsigned int paddingY;
+  float padValue;
+  std::function<void(const Mat2d<float>* tile, Mat2d<float>* output)> run;
+};
+
+// Applies `op` to a mapped input file and streams the result to a mapped output file.
+// Output tiles are distributed over the CPU threads; each thread owns one halo-extended
+// input tile buffer, so peak memory is about tile size x threads plus one window of mapped
+// bands (enough bands for one tile per thread), independent of the image size.
+bool tiledOutOfCore(
+    const char* inputPath,
+    const unsigned int width,
+    const unsigned int height,
+    const TileOp& op,
+    const char* outputPath,
+    Mat2d<float>* outputShape = nullptr,
+    const unsigned int tileWidth = 1024,
+    const unsigned int tileHeight = 1024) {
+
+  if (width < op.kernelWidth || height < op.kernelHeight) {
+    std::cout << "Input size must be greater than kernel size" << std::endl;
+    return false;
+  }
+
+  if (op.strideX == 0 || op.strideY == 0) {
+    std::cout << "Stride must be greater than 0" << std::endl;
+    return false;
+  }
+
+  if (tileWidth == 0 || tileHeight == 0) {
+    std::cout << "Tile size must be greater than 0" << std::endl;
+    return false;
+  }
+
+  MappedMat2d input;
+  if (!input.openRead(inputPath, width, height)) {
+    return false;
+  }
+
+  const unsigned int outWidth = (width - op.kernelWidth + 2 * op.paddingX) / op.strideX + 1;
+  const unsigned int outHeight = (height - op.kernelHeight + 2 * op.paddingY) / op.strideY + 1;
+  MappedMat2d output;
+  if (!output.create(outputPath, outWidth, outHeight)) {
+    return false;
+  }
+  if (outputShape) {
+    outputShape->data = nullptr;
+    outputShape->width = outWidth;
+    outputShape->height = outHeight;
+  }
+
+  const unsigned int tilesX = (outWidth + tileWidth - 1) / tileWidth;
+  const unsigned int tilesY = (outHeight + tileHeight - 1) / tileHeight;
+  const unsigned int maxTileInWidth = (std::min(tileWidth, outWidth) - 1) * op.strideX + op.kernelWidth;
+  const unsigned int maxTileInHeight = (std::min(tileHeight, outHeight) - 1) * op.strideY + op.kernelHeight;
+
+  const unsigned int workers = workerCount(tilesX * tilesY);
+  std::vector<std::vector<float>> buffers(workers);
+
+  // Tiles are scheduled over a window of whole bands (tile rows) holding at least one tile per
+  // worker, so narrow images still keep every thread busy; input rows above the window and output
+  // rows of finished windows are released, which bounds the mapped rows to one window.
+  const unsigned int bandsPerWindow = (workers + tilesX - 1) / tilesX;
+  unsigned int releasedInputRows = 0;
+  for (unsigned int band = 0; band < tilesY; band += bandsPerWindow) {
+    const unsigned int lastBand = std::min(tilesY, band + bandsPerWindow);
+
+    parallelForDynamic(workers, (size_t)(lastBand - band) * tilesX, 1, [&](const unsigned int worker, const size_t begin, const size_t end) {
+      std::vector<float>& buffer = buffers[worker];
+      if (buffer.empty()) {
+        buffer.resize((size_t)maxTileInWidth * maxTileInHeight);
+      }
+      for (size_t t = begin; t < end; ++t) {
+        const unsigned int ty = band + (unsigned int)(t / tilesX);
+        const unsigned int tx = (unsigned int)(t % tilesX);
+        const unsigned int oy0 = ty * tileHeight;
+        const unsigned int oy1 = std::min(outHeight, oy0 + tileHeight);
+        const unsigned int ox0 = tx * tileWidth;
+        const unsigned int ox1 = std::min(outWidth, ox0 + tileWidth);
+
+        // input window of the tile including the halo, in (possibly negative) input coordinates
+        const long x0 = (long)ox0 * op.strideX - op.paddingX;
+        const long y0 = (long)oy0 * op.strideY - op.paddingY;
+        Mat2d<float> tile = {buffer.data(),
+                             (ox1 - ox0 - 1) * op.strideX + op.kernelWidth,
+                             (oy1 - oy0 - 1) * op.strideY + op.kernelHeight};
+
+        for (unsigned int y = 0; y < tile.height; ++y) {
+          float* dst = tile.data + (size_t)y * tile.width;
+          const long iy = y0 + y;
+          if (iy < 0 || iy >= (long)height) {
+            std::fill(dst, dst + tile.width, op.padValue);
+            continue;
+          }
+          const long left = std::max(0l, -x0);
+          const long right = std::max(left, std::min((long)tile.width, (long)width - x0));
+          std::fill(dst, dst + left, op.padValue);
+          memcpy(dst + left, input.mat.data + (size_t)iy * width + x0 + left, sizeof(float) * (right - left));
+          std::fill(dst + right, dst + tile.width, op.padValue);
+        }
+
+        Mat2d<float> result = {nullptr, 0, 0};
+        op.run(&tile, &result);
+        if (!result.data) {
+          continue;
+        }
+        for (unsigned int y = 0; y < result.height; ++y) {
+          memcpy(output.mat.data + (size_t)(oy0 + y) * outWidth + ox0,
+                 result.data + (size_t)y * result.width,
+                 sizeof(float) * result.width);
+        }
+        delete[] result.data;
+      }
+    });
+
+    const unsigned int oy1 = std::min(outHeight, lastBand * tileHeight);
+    output.releaseRows(band * tileHeight, oy1);
+    const long nextTop = std::min((long)oy1 * op.strideY - op.paddingY, (long)height);
+    if (lastBand < tilesY && nextTop > (long)releasedInputRows) {
+      input.releaseRows(releasedInputRows, (unsigned int)nextTop);
+      releasedInputRows = (unsigned int)nextTop;
+    }
+  }
+
+  return true;
+}
+
+bool conv2dOutOfCore(
+    const char* inputPath,
+    const unsigned int width,
+    const unsigned int height,
+    const Mat2d<float>* kernel,
+    const char* outputPath,
+    Mat2d<float>* outputShape = nullptr,
+    const unsigned int strideX = 1,
+    const unsigned int strideY = 1,
+    const unsigned int paddingX = 0,
+    const unsigned int paddingY = 0) {
+  TileOp op = {kernel->width, kernel->height, strideX, strideY, paddingX, paddingY, 0.0f,
+               [=](const Mat2d<float>* tile, Mat2d<float>* output) {
+                 // the tile already holds its padding, so every kernel column reads inside it
+                 output->width = (tile->width - kernel->width) / strideX + 1;
+                 output->height = (tile->height - kernel->height) / strideY + 1;
+                 output->data = new float[(size_t)output->width * output->height];
+                 std::vector<unsigned int> first(kernel->width), last(kernel->width);
+                 for (unsigned int kx = 0; kx < kernel->width; ++kx) {
+                   validOutputRange(kx, tile->width, strideX, output->width, first[kx], last[kx]);
+                 }
+                 for (unsigned int oy = 0; oy < output->height; ++oy) {
+                   conv2dRowCPU(tile, kernel, oy, output->data + (size_t)oy * output->width, output->width,
+                                first.data(), last.data(), strideX, strideY, 0, 0);
+                 }
+               }};
+  return tiledOutOfCore(inputPath, width, height, op, outputPath, outputShape);
+}
+
+bool maxPoolOutOfCore(
+    const char* inputPath,
+    const unsigned int width,
+    const unsigned int height,
+    const unsigned int kernelWidth,
+    const unsigned int kernelHeight,
+    const char* outputPath,
+    Mat2d<float>* outputShape = nullptr,
+    const unsigned int strideX = 1,
+    const unsigned int strideY = 1,
+    const unsigned int paddingX = 0,
+    const unsigned int paddingY = 0) {
+  // padding never wins a max, same as the bounds check in maxPoolCPU
+  TileOp op = {kernelWidth, kernelHeight, strideX, strideY, paddingX, paddingY, -FLT_MAX,
+               [=](const Mat2d<float>* tile, Mat2d<float>* output) {
+                 maxPoolSeparableCPU(tile, kernelWidth, kernelHeight, output, strideX, strideY);
+               }};
+  return tiledOutOfCore(inputPath, width, height, op, outputPath, outputShape);
+}
+
+bool avgPoolOutOfCore(
+    const char* inputPath,
+    const unsigned int width,
+    const unsigned int height,
+    const unsigned int kernelWidth,
+    const unsigned int kernelHeight,
+    const char* outputPath,
+    Mat2d<float>* outputShape = nullptr,
+    const unsigned int strideX = 1,
+    const unsigned int strideY = 1,
+    const unsigned int paddingX = 0,
+    const unsigned int paddingY = 0) {
+  TileOp op = {kernelWidth, kernelHeight, strideX, strideY, paddingX, paddingY, 0.0f,
+               [=](const Mat2d<float>* tile, Mat2d<float>* output) {
+                 avgPoolIntegralCPU(tile, kernelWidth, kernelHeight, output, strideX, strideY);
+               }};
+  return tiledOutOfCore(inputPath, width, height, op, outputPath, outputShape);
+}
+
+#endif // OUT_OF_CORE_HPP
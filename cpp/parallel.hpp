@@ -0,0 +1,66 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Number of threads worth using for `count` items when every thread should get at least `grain` of them.
+inline unsigned int workerCount(const size_t count, const size_t grain = 1) {
+  const unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+  const size_t useful = std::max<size_t>(1, count / std::max<size_t>(1, grain));
+  return (unsigned int)std::min<size_t>(hardware, useful);
+}
+
+// Splits [0, count) into `workers` contiguous ranges and calls body(worker, begin, end) once per range.
+// Worker 0 runs on the calling thread.
+template <typename F>
+void parallelFor(const unsigned int workers, const size_t count, F&& body) {
+  if (workers <= 1 || count <= 1) {
+    body(0u, (size_t)0, count);
+    return;
+  }
+  std::vector<std::thread> threads;
+  threads.reserve(workers - 1);
+  for (unsigned int w = 1; w < workers; ++w) {
+    const size_t begin = count * w / workers;
+    const size_t end = count * (w + 1) / workers;
+    threads.emplace_back([&body, w, begin, end]() { body(w, begin, end); });
+  }
+  body(0u, (size_t)0, count / workers);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+// Hands out [0, count) in `chunk`-sized pieces from a shared counter, for work whose cost per item is uneven.
+template <typename F>
+void parallelForDynamic(const unsigned int workers, const size_t count, const size_t chunk, F&& body) {
+  std::atomic<size_t> nextItem(0);
+  auto worker = [&](const unsigned int w) {
+    while (true) {
+      const size_t begin = nextItem.fetch_add(chunk);
+      if (begin >= count) {
+        return;
+      }
+      body(w, begin, std::min(count, begin + chunk));
+    }
+  };
+  if (workers <= 1) {
+    worker(0);
+    return;
+  }
+  std::vector<std::thread> threads;
+  threads.reserve(workers - 1);
+  for (unsigned int w = 1; w < workers; ++w) {
+    threads.emplace_back(worker, w);
+  }
+  worker(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+#endif // PARALLEL_HPP
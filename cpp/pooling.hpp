@@ -0,0 +1,559 @@
+#ifndef POOLING_HPP
+#define POOLING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "mat2d.hpp"
+#include "parallel.hpp"
+#include "reduce.hpp"
+
+// Sliding-window max over a padded line, van Herk/Gil-Werman style. Position p of the padded line
+// is value(p) (-FLT_MAX in the padding). The line is split into blocks of `window`; suffix maxima
+// within each block go to `suffix`, prefix maxima are kept in a running value, and the window
+// starting at s is max(suffix[s], prefix[s + window - 1]): about 3 comparisons per element,
+// whatever the window size. Writes `count` outputs, window starts 0, stride, 2 * stride, ...
+template <typename Value, typename Emit>
+void slidingMaxLine(const unsigned int window, const unsigned int stride, const unsigned int count, float* suffix, Value value, Emit emit) {
+  const unsigned int length = (count - 1) * stride + window;
+  for (unsigned int p = length; p-- > 0;) {
+    const float v = value(p);
+    suffix[p] = (p + 1) % window == 0 || p + 1 == length ? v : std::max(v, suffix[p + 1]);
+  }
+  float prefix = -FLT_MAX;
+  unsigned int o = 0;
+  unsigned int end = window - 1;
+  for (unsigned int p = 0; o < count; ++p) {
+    const float v = value(p);
+    prefix = p % window == 0 ? v : std::max(prefix, v);
+    if (p == end) {
+      emit(o, std::max(suffix[end + 1 - window], prefix));
+      ++o;
+      end += stride;
+    }
+  }
+}
+
+// Max pooling with the same arguments and results as MetalConv::maxPoolCPU, separated into a
+// horizontal and a vertical van Herk/Gil-Werman pass so the cost per output does not grow with
+// the window. Rows are split across threads for the horizontal pass, column strips for the
+// vertical pass.
+void maxPoolSeparableCPU(
+    const Mat2d<float>* input,
+    const unsigned int kernelWidth,
+    const unsigned int kernelHeight,
+    Mat2d<float>* output,
+    const unsigned int strideX = 1,
+    const unsigned int strideY = 1,
+    const unsigned int paddingX = 0,
+    const unsigned int paddingY = 0) {
+  if (input->width < kernelWidth || input->height < kernelHeight) {
+    std::cout << "Input size must be greater than kernel size" << std::endl;
+    return;
+  }
+
+  if (strideX == 0 || strideY == 0) {
+    std::cout << "Stride must be greater than 0" << std::endl;
+    return;
+  }
+
+  output->width = (input->width - kernelWidth + 2 * paddingX) / strideX + 1;
+  output->height = (input->height - kernelHeight + 2 * paddingY) / strideY + 1;
+  output->data = new float[output->width * output->height];
+
+  const unsigned int inWidth = input->width;
+  const unsigned int inHeight = input->height;
+  const unsigned int outWidth = output->width;
+  const unsigned int outHeight = output->height;
+
+  // horizontal pass: inHeight x outWidth
+  float* rowMax = new float[(size_t)inHeight * outWidth];
+  const unsigned int rowLength = (outWidth - 1) * strideX + kernelWidth;
+  parallelFor(workerCount(inHeight, 64), inHeight, [&](unsigned int, const size_t begin, const size_t end) {
+    std::vector<float> suffix(rowLength);
+    for (size_t y = begin; y < end; ++y) {
+      const float* in = input->data + y * inWidth;
+      float* out = rowMax + y * outWidth;
+      slidingMaxLine(
+          kernelWidth, strideX, outWidth, suffix.data(),
+          [=](const unsigned int p) {
+            const unsigned int x = p - paddingX;
+            return x < inWidth ? in[x] : -FLT_MAX;
+          },
+          [=](const unsigned int ox, const float max) { out[ox] = max; });
+    }
+  });
+
+  // vertical pass over column strips, whole rows of a strip at a time so the inner loops vectorize
+  const unsigned int STRIP = 64;
+  const unsigned int strips = (outWidth + STRIP - 1) / STRIP;
+  const unsigned int columnLength = (outHeight - 1) * strideY + kernelHeight;
+  parallelFor(workerCount(strips), strips, [&](unsigned int, const size_t begin, const size_t end) {
+    std::vector<float> suffix((size_t)columnLength * STRIP);
+    std::vector<float> prefix(STRIP);
+    for (size_t strip = begin; strip < end; ++strip) {
+      const unsigned int x0 = (unsigned int)strip * STRIP;
+      const unsigned int width = std::min(STRIP, outWidth - x0);
+      auto row = [&](const unsigned int p) -> const float* {
+        const unsigned int y = p - paddingY;
+        return y < inHeight ? rowMax + (size_t)y * outWidth + x0 : nullptr;
+      };
+
+      for (unsigned int p = columnLength; p-- > 0;) {
+        const float* r = row(p);
+        float* s = suffix.data() + (size_t)p * STRIP;
+        const bool blockEnd = (p + 1) % kernelHeight == 0 || p + 1 == columnLength;
+        for (unsigned int x = 0; x < width; ++x) {
+          const float v = r ? r[x] : -FLT_MAX;
+          s[x] = blockEnd ? v : std::max(v, s[x + STRIP]);
+        }
+      }
+
+      unsigned int oy = 0;
+      unsigned int last = kernelHeight - 1;
+      for (unsigned int p = 0; oy < outHeight; ++p) {
+        const float* r = row(p);
+        const bool blockStart = p % kernelHeight == 0;
+        for (unsigned int x = 0; x < width; ++x) {
+          const float v = r ? r[x] : -FLT_MAX;
+          prefix[x] = blockStart ? v : std::max(prefix[x], v);
+        }
+        if (p == last) {
+          const float* s = suffix.data() + (size_t)(last + 1 - kernelHeight) * STRIP;
+          float* out = output->data + (size_t)oy * outWidth + x0;
+          for (unsigned int x = 0; x < width; ++x) {
+            out[x] = std::max(s[x], prefix[x]);
+          }
+          ++oy;
+          last += strideY;
+        }
+      }
+    }
+  });
+
+  delete[] rowMax;
+}
+
+// avgPoolCPU switches to avgPoolIntegralCPU once kernel area x outputs reaches this many times the
+// input size (about the window area at stride 1). An estimate from operation counts, not a
+// measurement: the direct loop costs one add per window element, the summed-area table a few
+// double adds per input pixel to build plus 4 lookups per output, so the table should win from
+// 3 x 3 windows on. Re-tune it on the target machine if pooling speed matters.
+const unsigned int AVG_POOL_INTEGRAL_CROSSOVER = 6;
+
+// Average pooling with the same arguments as MetalConv::avgPoolCPU, computed from a summed-area
+// table: every window sum is 4 lookups, whatever the window size or stride. The table is
+// accumulated in double so window sums of large images keep float precision after the
+// subtraction. Padding counts as zeros, as in avgPoolCPU.
+void avgPoolIntegralCPU(
+    const Mat2d<float>* input,
+    const unsigned int kernelWidth,
+    const unsigned int kernelHeight,
+    Mat2d<float>* output,
+    const unsigned int strideX = 1,
+    const unsigned int strideY = 1,
+    const unsigned int paddingX = 0,
+    const unsigned int paddingY = 0) {
+  if (input->width < kernelWidth || input->height < kernelHeight) {
+    std::cout << "Input size must be greater than kernel size" << std::endl;
+    return;
+  }
+
+  if (strideX == 0 || strideY == 0) {
+    std::cout << "Stride must be greater than 0" << std::endl;
+    return;
+  }
+
+  output->width = (input->width - kernelWidth + 2 * paddingX) / strideX + 1;
+  output->height = (input->height - kernelHeight + 2 * paddingY) / strideY + 1;
+  output->data = new float[output->width * output->height];
+
+  const unsigned int inWidth = input->width;
+  const unsigned int inHeight = input->height;
+  const unsigned int outWidth = output->width;
+  const unsigned int outHeight = output->height;
+
+  // sat[y][x] = sum of input[0..y)[0..x)
+  const size_t satWidth = (size_t)inWidth + 1;
+  double* sat = new double[satWidth * (inHeight + 1)];
+  std::fill(sat, sat + satWidth, 0.0);
+  parallelFor(workerCount(inHeight, 64), inHeight, [&](unsigned int, const size_t begin, const size_t end) {
+    for (size_t y = begin; y < end; ++y) {
+      const float* in = input->data + y * inWidth;
+      double* row = sat + (y + 1) * satWidth;
+      double sum = 0.0;
+      row[0] = 0.0;
+      for (unsigned int x = 0; x < inWidth; ++x) {
+        sum += in[x];
+        row[x + 1] = sum;
+      }
+    }
+  });
+  const size_t STRIP = 256;
+  const size_t strips = (satWidth + STRIP - 1) / STRIP;
+  parallelFor(workerCount(strips), strips, [&](unsigned int, const size_t begin, const size_t end) {
+    for (size_t strip = begin; strip < end; ++strip) {
+      const size_t x0 = strip * STRIP;
+      const size_t x1 = std::min(satWidth, x0 + STRIP);
+      for (unsigned int y = 1; y <= inHeight; ++y) {
+        const double* above = sat + (y - 1) * satWidth;
+        double* row = sat + y * satWidth;
+        for (size_t x = x0; x < x1; ++x) {
+          row[x] += above[x];
+        }
+      }
+    }
+  });
+
+  // window bounds clipped to the image, in table coordinates
+  auto clip = [](const long v, const unsigned int size) {
+    return (unsigned int)std::min<long>(std::max(0l, v), size);
+  };
+  std::vector<unsigned int> left(outWidth), right(outWidth);
+  for (unsigned int ox = 0; ox < outWidth; ++ox) {
+    const long x = (long)ox * strideX - paddingX;
+    left[ox] = clip(x, inWidth);
+    right[ox] = clip(x + kernelWidth, inWidth);
+  }
+  const double area = (double)kernelWidth * kernelHeight;
+  parallelFor(workerCount(outHeight, 16), outHeight, [&](unsigned int, const size_t begin, const size_t end) {
+    for (size_t oy = begin; oy < end; ++oy) {
+      const long y = (long)oy * strideY - paddingY;
+      const double* top = sat + clip(y, inHeight) * satWidth;
+      const double* bottom = sat + clip(y + kernelHeight, inHeight) * satWidth;
+      float* out = output->data + oy * outWidth;
+      for (unsigned int ox = 0; ox < outWidth; ++ox) {
+        const double sum = bottom[right[ox]] - bottom[left[ox]] - top[right[ox]] + top[left[ox]];
+        out[ox] = (float)(sum / area);
+      }
+    }
+  });
+
+  delete[] sat;
+}
+
+// Output positions [first, last) whose input position o * stride + offset lies inside [0, size).
+void validOutputRange(const long offset, const unsigned int size, const unsigned int stride, const unsigned int outSize, unsigned int& first, unsigned int& last) {
+  first = offset >= 0 ? 0 : (unsigned int)std::min<long>((-offset + stride - 1) / stride, outSize);
+  const long end = (long)size - 1 - offset;
+  last = end < 0 ? 0 : (unsigned int)std::min<long>(end / stride + 1, outSize);
+  first = std::min(first, last);
+}
+
+// Input range [begin, end) of window o (start o * stride - padding, length kernel) clipped to [0, size).
+void clippedWindow(const unsigned int o, const unsigned int stride, const unsigned int padding, const unsigned int kernel, const unsigned int size, unsigned int& begin, unsigned int& end) {
+  const long start = (long)o * stride - padding;
+  begin = (unsigned int)std::min<long>(std::max(0l, start), size);
+  end = (unsigned int)std::min<long>(std::max(0l, start + kernel), size);
+}
+
+// Index stored for a window that lies entirely in the padding (or holds only NaN).
+const uint32_t MAX_POOL_NO_INDEX = UINT32_MAX;
+
+// maxPoolCPU that also writes, for every output, the flat input index (iy * width + ix) of the
+// maximum, for maxUnpoolCPU and backprop. Ties keep the first element in row-major window order,
+// as maxPoolCPU does. A window of only -inf pools to -inf at its first element (maxPoolCPU gives
+// -FLT_MAX there), so maxUnpoolCPU still restores it. Output rows are split across threads; each
+// row is built with one branch-free compare/select pass per kernel tap so the inner loop
+// vectorizes.
+void maxPoolWithIndicesCPU(
+    const Mat2d<float>* input,
+    const unsigned int kernelWidth,
+    const unsigned int kernelHeight,
+    Mat2d<float>* output,
+    Mat2d<uint32_t>* indices,
+    const unsigned int strideX = 1,
+    const unsigned int strideY = 1,
+    const unsigned int paddingX = 0,
+    const unsigned int paddingY = 0) {
+  if (input->width < kernelWidth || input->height < kernelHeight) {
+    std::cout << "Input size must be greater than kernel size" << std::endl;
+    return;
+  }
+
+  if (strideX == 0 || strideY == 0) {
+    std::cout << "Stride must be greater than 0" << std::endl;
+    return;
+  }
+
+  output->width = (input->width - kernelWidth + 2 * paddingX) / strideX + 1;
+  output->height = (input->height - kernelHeight + 2 * paddingY) / strideY + 1;
+  output->data = new float[output->width * output->height];
+  indices->width = output->width;
+  indices->height = output->height;
+  indices->data = new uint32_t[output->width * output->height];
+
+  const unsigned int inWidth = input->width;
+  const unsigned int inHeight = input->height;
+  const unsigned int outWidth = output->width;
+
+  std::vector<unsigned int> first(kernelWidth), last(kernelWidth);
+  for (unsigned int kx = 0; kx < kernelWidth; ++kx) {
+    validOutputRange((long)kx - paddingX, inWidth, strideX, outWidth, first[kx], last[kx]);
+  }
+
+  parallelFor(workerCount(output->height, 16), output->height, [&](unsigned int, const size_t begin, const size_t end) {
+    for (size_t oy = begin; oy < end; ++oy) {
+      float* best = output->data + oy * outWidth;
+      uint32_t* arg = indices->data + oy * outWidth;
+      for (unsigned int ox = 0; ox < outWidth; ++ox) {
+        best[ox] = -INFINITY;
+        arg[ox] = MAX_POOL_NO_INDEX;
+      }
+      for (unsigned int ky = 0; ky < kernelHeight; ++ky) {
+        const unsigned int iy = (unsigned int)oy * strideY + ky - paddingY;
+        if (iy >= inHeight) {
+          continue;
+        }
+        const float* in = input->data + (size_t)iy * inWidth;
+        for (unsigned int kx = 0; kx < kernelWidth; ++kx) {
+          const uint32_t base = iy * inWidth + kx - paddingX;
+          for (unsigned int ox = first[kx]; ox < last[kx]; ++ox) {
+            const uint32_t i = base + ox * strideX;
+            const float v = in[ox * strideX + kx - paddingX];
+            // -inf is a valid maximum: the first one fills an empty window
+            const bool take = v > best[ox] || (v == best[ox] && arg[ox] == MAX_POOL_NO_INDEX);
+            best[ox] = take ? v : best[ox];
+            arg[ox] = take ? i : arg[ox];
+          }
+        }
+      }
+      for (unsigned int ox = 0; ox < outWidth; ++ox) {
+        best[ox] = arg[ox] == MAX_POOL_NO_INDEX ? -FLT_MAX : best[ox];
+      }
+    }
+  });
+}
+
+// Scatters every pooled value back to the input position recorded by maxPoolWithIndicesCPU;
+// all other positions of the outputWidth x outputHeight result are zero. Overlapping windows
+// can record the same position from two threads. With the pooled values themselves both stores
+// write the same number, but input may be anything of the pooled shape (e.g. gradients), and then
+// they differ; the stores are relaxed atomics so that case is a defined race where one of the two
+// values wins, rather than undefined behavior. A relaxed atomic float store is a plain store.
+void maxUnpoolCPU(
+    const Mat2d<float>* input,
+    const Mat2d<uint32_t>* indices,
+    const unsigned int outputWidth,
+    const unsigned int outputHeight,
+    Mat2d<float>* output) {
+  if (input->width != indices->width || input->height != indices->height) {
+    std::cout << "Indices size must match input size" << std::endl;
+    return;
+  }
+
+  output->width = outputWidth;
+  output->height = outputHeight;
+  const size_t outSize = (size_t)outputWidth * outputHeight;
+  output->data = new float[outSize];
+
+  parallelFor(workerCount(outSize, 1 << 16), outSize, [&](unsigned int, const size_t begin, const size_t end) {
+    std::fill(output->data + begin, output->data + end, 0.0f);
+  });
+
+  const size_t inSize = (size_t)input->width * input->height;
+  parallelFor(workerCount(inSize, 1 << 14), inSize, [&](unsigned int, const size_t begin, const size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const uint32_t index = indices->data[i];
+      if (index < outSize) {
+        std::atomic_ref<float>(output->data[index]).store(input->data[i], std::memory_order_relaxed);
+      }
+    }
+  });
+}
+
+// Mean of all elements: a parallel reduction with one partial per thread instead of an
+// avgPoolCPU call whose single window covers the input.
+float globalAvgPoolCPU(const Mat2d<float>* input) {
+  const size_t size = (size_t)input->width * input->height;
+  if (size == 0) {
+    std::cout << "Input must not be empty" << std::endl;
+    return 0.0f;
+  }
+  const unsigned int workers = workerCount(size, 1 << 16);
+  std::vector<double> partials(workers);
+  parallelFor(workers, size, [&](const unsigned int worker, const size_t begin, const size_t end) {
+    partials[worker] = sumPairwise(input->data + begin, end - begin);
+  });
+  return (float)(combinePairwise(partials.data(), partials.size()) / size);
+}
+
+// Max of all elements, split into one partial per thread like globalAvgPoolCPU; an input of only
+// -inf gives -inf.
+float globalMaxPoolCPU(const Mat2d<float>* input) {
+  const size_t size = (size_t)input->width * input->height;
+  if (size == 0) {
+    std::cout << "Input must not be empty" << std::endl;
+    return -FLT_MAX;
+  }
+  const unsigned int workers = workerCount(size, 1 << 16);
+  std::vector<float> partials(workers);
+  parallelFor(workers, size, [&](const unsigned int worker, const size_t begin, const size_t end) {
+    partials[worker] = maxFloats(input->data + begin, end - begin);
+  });
+  return *std::max_element(partials.begin(), partials.end());
+}
+
+// Adaptive pooling window [start, end) of output o when `size` inputs map to `outSize` outputs:
+// floor(o * size / outSize) to ceil((o + 1) * size / outSize), so windows vary by one and may overlap.
+void adaptiveWindow(const unsigned int o, const unsigned int size, const unsigned int outSize, unsigned int& start, unsigned int& end) {
+  start = (unsigned int)((size_t)o * size / outSize);
+  end = (unsigned int)(((size_t)o + 1) * size / outSize + (((size_t)o + 1) * size % outSize != 0));
+}
+
+// Folds the rows `sources` into one row over columns [begin, end), then reduces each output
+// column's slice of that range into partials[ox] (init for columns outside the range).
+template <typename Fold>
+void adaptiveFoldColumns(
+    const std::vector<const float*>& sources,
+    float* folded,
+    const size_t begin,
+    const size_t end,
+    const std::vector<unsigned int>& left,
+    const std::vector<unsigned int>& right,
+    float* partials,
+    const float init,
+    Fold fold) {
+  std::fill(folded + begin, folded + end, init);
+  for (const float* in : sources) {
+    for (size_t x = begin; x < end; ++x) {
+      folded[x] = fold(folded[x], in[x]);
+    }
+  }
+  for (size_t ox = 0; ox < left.size(); ++ox) {
+    float acc = init;
+    for (size_t x = std::max<size_t>(left[ox], begin); x < std::min<size_t>(right[ox], end); ++x) {
+      acc = fold(acc, folded[x]);
+    }
+    partials[ox] = acc;
+  }
+}
+
+// Shared driver for adaptive pooling. For each output row the window's input rows are first
+// folded into one row (contiguous, vectorized), then each output column reduces its slice of it.
+// Output rows are split across threads when there are enough of them. Small outputs (1 x 1,
+// 7 x 7) instead split each window: its input rows are folded by all threads into one partial
+// row each (when it has at least a row per thread), then the columns of the folded row are
+// split, and the per-thread column partials are combined.
+template <typename Fold, typename Finish>
+void adaptivePool(
+    const Mat2d<float>* input,
+    const unsigned int outputWidth,
+    const unsigned int outputHeight,
+    Mat2d<float>* output,
+    const float init,
+    Fold fold,
+    Finish finish) {
+  if (outputWidth == 0 || outputHeight == 0 || input->width < outputWidth || input->height < outputHeight) {
+    std::cout << "Output size must be between 1 and input size" << std::endl;
+    return;
+  }
+
+  output->width = outputWidth;
+  output->height = outputHeight;
+  output->data = new float[outputWidth * outputHeight];
+
+  const unsigned int inWidth = input->width;
+  std::vector<unsigned int> left(outputWidth), right(outputWidth);
+  for (unsigned int ox = 0; ox < outputWidth; ++ox) {
+    adaptiveWindow(ox, inWidth, outputWidth, left[ox], right[ox]);
+  }
+
+  const unsigned int workers = workerCount((size_t)inWidth * input->height, 1 << 16);
+  if (outputHeight >= workers) {
+    parallelFor(workers, outputHeight, [&](unsigned int, const size_t begin, const size_t end) {
+      std::vector<float> folded(inWidth);
+      for (size_t oy = begin; oy < end; ++oy) {
+        unsigned int top, bottom;
+        adaptiveWindow((unsigned int)oy, input->height, outputHeight, top, bottom);
+        std::fill(folded.begin(), folded.end(), init);
+        for (unsigned int y = top; y < bottom; ++y) {
+          const float* in = input->data + (size_t)y * inWidth;
+          for (unsigned int x = 0; x < inWidth; ++x) {
+            folded[x] = fold(folded[x], in[x]);
+          }
+        }
+        float* out = output->data + oy * outputWidth;
+        for (unsigned int ox = 0; ox < outputWidth; ++ox) {
+          float acc = init;
+          for (unsigned int x = left[ox]; x < right[ox]; ++x) {
+            acc = fold(acc, folded[x]);
+          }
+          out[ox] = finish(acc, (right[ox] - left[ox]) * (bottom - top));
+        }
+      }
+    });
+    return;
+  }
+
+  std::vector<float> rowPartials((size_t)workers * inWidth);
+  std::vector<float> folded(inWidth);
+  std::vector<float> columnPartials((size_t)workers * outputWidth);
+  std::vector<const float*> sources;
+  for (unsigned int oy = 0; oy < outputHeight; ++oy) {
+    unsigned int top, bottom;
+    adaptiveWindow(oy, input->height, outputHeight, top, bottom);
+    sources.clear();
+    if (bottom - top >= workers) {
+      parallelFor(workers, bottom - top, [&](const unsigned int worker, const size_t begin, const size_t end) {
+        float* partial = rowPartials.data() + (size_t)worker * inWidth;
+        std::fill(partial, partial + inWidth, init);
+        for (size_t y = top + begin; y < top + end; ++y) {
+          const float* in = input->data + y * inWidth;
+          for (unsigned int x = 0; x < inWidth; ++x) {
+            partial[x] = fold(partial[x], in[x]);
+          }
+        }
+      });
+      for (unsigned int w = 0; w < workers; ++w) {
+        sources.push_back(rowPartials.data() + (size_t)w * inWidth);
+      }
+    } else {
+      for (unsigned int y = top; y < bottom; ++y) {
+        sources.push_back(input->data + (size_t)y * inWidth);
+      }
+    }
+    parallelFor(workers, inWidth, [&](const unsigned int worker, const size_t begin, const size_t end) {
+      adaptiveFoldColumns(sources, folded.data(), begin, end, left, right,
+                          columnPartials.data() + (size_t)worker * outputWidth, init, fold);
+    });
+    float* out = output->data + (size_t)oy * outputWidth;
+    for (unsigned int ox = 0; ox < outputWidth; ++ox) {
+      float acc = init;
+      for (unsigned int w = 0; w < workers; ++w) {
+        acc = fold(acc, columnPartials[(size_t)w * outputWidth + ox]);
+      }
+      out[ox] = finish(acc, (right[ox] - left[ox]) * (bottom - top));
+    }
+  }
+}
+
+// Pools the input down to a fixed outputWidth x outputHeight, averaging each variable-size window.
+void adaptiveAvgPoolCPU(
+    const Mat2d<float>* input,
+    const unsigned int outputWidth,
+    const unsigned int outputHeight,
+    Mat2d<float>* output) {
+  adaptivePool(
+      input, outputWidth, outputHeight, output, 0.0f,
+      [](const float a, const float b) { return a + b; },
+      [](const float sum, const unsigned int count) { return sum / count; });
+}
+
+void adaptiveMaxPoolCPU(
+    const Mat2d<float>* input,
+    const unsigned int outputWidth,
+    const unsigned int outputHeight,
+    Mat2d<float>* output) {
+  adaptivePool(
+      input, outputWidth, outputHeight, output, -FLT_MAX,
+      [](const float a, const float b) { return std::max(a, b); },
+      [](const float max, const unsigned int) { return max; });
+}
+
+#endif // POOLING_HPP
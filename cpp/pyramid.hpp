@@ -0,0 +1,70 @@
+#ifndef PYRAMID_HPP
+#define PYRAMID_HPP
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "mat2d.hpp"
+#include "parallel.hpp"
+
+// Average image pyramid. levels[0] is a view of the input; levels[l] is levels[l - 1] pooled
+// with a 2 x 2 average, stride 2 (avgPoolCPU(levels[l - 1], 2, 2, ..., 2, 2)). Levels 1..n are
+// views into one contiguous buffer, `data`, which the caller releases with delete[].
+struct Pyramid {
+  float* data;
+  std::vector<Mat2d<float>> levels;
+};
+
+// Builds every level in one traversal. The input is cut into bands of 2^levels rows; a band
+// produces a fixed number of rows at each level from the rows it has just written one level up,
+// so intermediate rows are still in cache when they are read again. Bands are independent and are
+// split across threads.
+void avgPyramidCPU(
+    const Mat2d<float>* input,
+    const unsigned int levels,
+    Pyramid* pyramid) {
+  if (levels == 0 || levels >= 32 || (input->width >> levels) == 0 || (input->height >> levels) == 0) {
+    std::cout << "Input size must be at least 2^levels" << std::endl;
+    return;
+  }
+
+  pyramid->levels.assign(levels + 1, *input);
+  size_t total = 0;
+  for (unsigned int l = 1; l <= levels; ++l) {
+    pyramid->levels[l].width = pyramid->levels[l - 1].width / 2;
+    pyramid->levels[l].height = pyramid->levels[l - 1].height / 2;
+    total += (size_t)pyramid->levels[l].width * pyramid->levels[l].height;
+  }
+  pyramid->data = new float[total];
+  float* next = pyramid->data;
+  for (unsigned int l = 1; l <= levels; ++l) {
+    pyramid->levels[l].data = next;
+    next += (size_t)pyramid->levels[l].width * pyramid->levels[l].height;
+  }
+
+  // band b covers level-l rows [b << (levels - l), (b + 1) << (levels - l))
+  const std::vector<Mat2d<float>>& level = pyramid->levels;
+  const unsigned int rowsPerBand = 1u << (levels - 1);
+  const unsigned int bands = (level[1].height + rowsPerBand - 1) / rowsPerBand;
+  parallelFor(workerCount(bands), bands, [&](unsigned int, const size_t begin, const size_t end) {
+    for (size_t band = begin; band < end; ++band) {
+      for (unsigned int l = 1; l <= levels; ++l) {
+        const Mat2d<float>& src = level[l - 1];
+        const Mat2d<float>& dst = level[l];
+        const unsigned int first = (unsigned int)band << (levels - l);
+        const unsigned int last = std::min(dst.height, first + (1u << (levels - l)));
+        for (unsigned int y = first; y < last; ++y) {
+          const float* a = src.data + (size_t)(2 * y) * src.width;
+          const float* b = a + src.width;
+          float* out = dst.data + (size_t)y * dst.width;
+          for (unsigned int x = 0; x < dst.width; ++x) {
+            out[x] = (a[2 * x] + a[2 * x + 1] + b[2 * x] + b[2 * x + 1]) / 4;
+          }
+        }
+      }
+    }
+  });
+}
+
+#endif // PYRAMID_HPP
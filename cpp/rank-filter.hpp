@@ -0,0 +1,294 @@
+#ifndef RANK_FILTER_HPP
+#define RANK_FILTER_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "mat2d.hpp"
+#include "parallel.hpp"
+#include "pooling.hpp"
+
+// Rank (percentile) filters with the window, stride and padding semantics of maxPoolCPU: padding
+// is ignored, and each output is element floor(percentile * (n - 1)) of the n in-bounds window
+// values in ascending order (percentile 0.5 gives the lower median). An output whose window lies
+// entirely in the padding is 0. Float NaNs rank above +inf.
+
+bool rankFilterShape(
+    const unsigned int width,
+    const unsigned int height,
+    const unsigned int kernelWidth,
+    const unsigned int kernelHeight,
+    const unsigned int strideX,
+    const unsigned int strideY,
+    const unsigned int paddingX,
+    const unsigned int paddingY,
+    unsigned int& outWidth,
+    unsigned int& outHeight) {
+  if (width < kernelWidth || height < kernelHeight || kernelWidth == 0 || kernelHeight == 0) {
+    std::cout << "Input size must be greater than kernel size" << std::endl;
+    return false;
+  }
+
+  if (strideX == 0 || strideY == 0) {
+    std::cout << "Stride must be greater than 0" << std::endl;
+    return false;
+  }
+
+  outWidth = (width - kernelWidth + 2 * paddingX) / strideX + 1;
+  outHeight = (height - kernelHeight + 2 * paddingY) / strideY + 1;
+  return true;
+}
+
+unsigned int rankOf(const float percentile, const unsigned int count) {
+  const float p = std::min(1.0f, std::max(0.0f, percentile));
+  return std::min(count - 1, (unsigned int)(p * (count - 1)));
+}
+
+// Order-preserving uint32 key of a float. Every NaN maps to the largest key, so keys are totally
+// ordered and two NaNs compare equal, which the sorted-window merges and removals below rely on.
+inline uint32_t rankKey(const float v) {
+  const uint32_t bits = std::bit_cast<uint32_t>(v);
+  const uint32_t key = bits ^ ((uint32_t)((int32_t)bits >> 31) | 0x80000000u);
+  return (bits & 0x7fffffffu) > 0x7f800000u ? UINT32_MAX : key;
+}
+
+inline float rankValue(const uint32_t key) {
+  return std::bit_cast<float>(key ^ (((key >> 31) - 1) | 0x80000000u));
+}
+
+// Float data: every input column of the window is kept sorted, and the sorted window is slid
+// across the row by removing the leaving columns and merging in the entering ones. Both are linear
+// merges, so an output costs O(kernelWidth * kernelHeight) instead of a per-window sort. Values are
+// sorted as rankKey keys.
+void rankFilterCPU(
+    const Mat2d<float>* input,
+    const unsigned int kernelWidth,
+    const unsigned int kernelHeight,
+    const float percentile,
+    Mat2d<float>* output,
+    const unsigned int strideX = 1,
+    const unsigned int strideY = 1,
+    const unsigned int paddingX = 0,
+    const unsigned int paddingY = 0) {
+  unsigned int outWidth, outHeight;
+  if (!rankFilterShape(input->width, input->height, kernelWidth, kernelHeight, strideX, strideY, paddingX, paddingY, outWidth, outHeight)) {
+    return;
+  }
+  output->width = outWidth;
+  output->height = outHeight;
+  output->data = new float[outWidth * outHeight];
+
+  const unsigned int width = input->width;
+  parallelFor(workerCount(outHeight), outHeight, [&](unsigned int, const size_t begin, const size_t end) {
+    std::vector<uint32_t> columns((size_t)width * kernelHeight);
+    std::vector<uint32_t> window, scratch, moving;
+    window.reserve((size_t)kernelWidth * kernelHeight);
+    scratch.reserve((size_t)kernelWidth * kernelHeight);
+    moving.reserve((size_t)kernelWidth * kernelHeight);
+
+    for (size_t oy = begin; oy < end; ++oy) {
+      unsigned int top, bottom;
+      clippedWindow((unsigned int)oy, strideY, paddingY, kernelHeight, input->height, top, bottom);
+      const unsigned int rows = bottom - top;
+      float* out = output->data + oy * outWidth;
+      if (rows == 0) {
+        std::fill(out, out + outWidth, 0.0f);
+        continue;
+      }
+
+      // sorted column x lives at columns[x * kernelHeight, x * kernelHeight + rows)
+      unsigned int firstColumn, lastColumn, unused;
+      clippedWindow(0, strideX, paddingX, kernelWidth, width, firstColumn, unused);
+      clippedWindow(outWidth - 1, strideX, paddingX, kernelWidth, width, unused, lastColumn);
+      for (unsigned int x = firstColumn; x < lastColumn; ++x) {
+        uint32_t* column = columns.data() + (size_t)x * kernelHeight;
+        for (unsigned int y = 0; y < rows; ++y) {
+          column[y] = rankKey(input->data[(size_t)(top + y) * width + x]);
+        }
+        std::sort(column, column + rows);
+      }
+      auto column = [&](const unsigned int x) { return columns.data() + (size_t)x * kernelHeight; };
+
+      window.clear();
+      unsigned int left = 0, right = 0;
+      for (unsigned int ox = 0; ox < outWidth; ++ox) {
+        unsigned int l, r;
+        clippedWindow(ox, strideX, paddingX, kernelWidth, width, l, r);
+
+        // window edges only move right: drop columns left of l, merge in columns past the old right edge
+        const unsigned int removeEnd = std::min(l, right);
+        if (left < removeEnd) {
+          moving.clear();
+          for (unsigned int x = left; x < removeEnd; ++x) {
+            const size_t mid = moving.size();
+            moving.insert(moving.end(), column(x), column(x) + rows);
+            std::inplace_merge(moving.begin(), moving.begin() + mid, moving.end());
+          }
+          scratch.clear();
+          size_t j = 0;
+          for (const uint32_t v : window) {
+            if (j < moving.size() && v == moving[j]) {
+              ++j;
+            } else {
+              scratch.push_back(v);
+            }
+          }
+          window.swap(scratch);
+        }
+
+        for (unsigned int x = std::max(l, right); x < r; ++x) {
+          scratch.resize(window.size() + rows);
+          std::merge(window.begin(), window.end(), column(x), column(x) + rows, scratch.begin());
+          window.swap(scratch);
+        }
+        left = l;
+        right = r;
+
+        out[ox] = window.empty() ? 0.0f : rankValue(window[rankOf(percentile, (unsigned int)window.size())]);
+      }
+    }
+  });
+}
+
+void medianFilterCPU(
+    const Mat2d<float>* input,
+    const unsigned int kernelWidth,
+    const unsigned int kernelHeight,
+    Mat2d<float>* output,
+    const unsigned int strideX = 1,
+    const unsigned int strideY = 1,
+    const unsigned int paddingX = 0,
+    const unsigned int paddingY = 0) {
+  rankFilterCPU(input, kernelWidth, kernelHeight, 0.5f, output, strideX, strideY, paddingX, paddingY);
+}
+
+// 8-bit data: Perreault-Hebert constant-time filter. Every input column keeps a 256-bin histogram
+// of its window rows, updated incrementally as the window moves down; the window histogram is
+// updated by adding and subtracting whole column histograms as it moves right, and the rank is
+// found through 16 coarse bins and 16 fine bins. Cost per output does not depend on the kernel
+// size. Output rows are split into one band per thread.
+void rankFilterCPU(
+    const Mat2d<uint8_t>* input,
+    const unsigned int kernelWidth,
+    const unsigned int kernelHeight,
+    const float percentile,
+    Mat2d<uint8_t>* output,
+    const unsigned int strideX = 1,
+    const unsigned int strideY = 1,
+    const unsigned int paddingX = 0,
+    const unsigned int paddingY = 0) {
+  unsigned int outWidth, outHeight;
+  if (!rankFilterShape(input->width, input->height, kernelWidth, kernelHeight, strideX, strideY, paddingX, paddingY, outWidth, outHeight)) {
+    return;
+  }
+  if (kernelHeight > UINT16_MAX) {
+    std::cout << "Kernel height must be at most " << UINT16_MAX << std::endl;
+    return;
+  }
+  output->width = outWidth;
+  output->height = outHeight;
+  output->data = new uint8_t[outWidth * outHeight];
+
+  const unsigned int width = input->width;
+  const unsigned int BINS = 256;
+  const unsigned int COARSE = 16;
+
+  parallelFor(workerCount(outHeight, 8), outHeight, [&](unsigned int, const size_t begin, const size_t end) {
+    std::vector<uint16_t> columnFine((size_t)width * BINS, 0);
+    std::vector<uint16_t> columnCoarse((size_t)width * COARSE, 0);
+    uint32_t fine[BINS];
+    uint32_t coarse[COARSE];
+
+    auto updateRow = [&](const unsigned int y, const int delta) {
+      const uint8_t* in = input->data + (size_t)y * width;
+      for (unsigned int x = 0; x < width; ++x) {
+        columnFine[(size_t)x * BINS + in[x]] += delta;
+        columnCoarse[(size_t)x * COARSE + in[x] / COARSE] += delta;
+      }
+    };
+    auto updateColumn = [&](const unsigned int x, const int sign) {
+      const uint16_t* f = columnFine.data() + (size_t)x * BINS;
+      const uint16_t* c = columnCoarse.data() + (size_t)x * COARSE;
+      if (sign > 0) {
+        for (unsigned int b = 0; b < BINS; ++b) {
+          fine[b] += f[b];
+        }
+        for (unsigned int b = 0; b < COARSE; ++b) {
+          coarse[b] += c[b];
+        }
+      } else {
+        for (unsigned int b = 0; b < BINS; ++b) {
+          fine[b] -= f[b];
+        }
+        for (unsigned int b = 0; b < COARSE; ++b) {
+          coarse[b] -= c[b];
+        }
+      }
+    };
+
+    unsigned int top = 0, bottom = 0;
+    for (size_t oy = begin; oy < end; ++oy) {
+      unsigned int t, b;
+      clippedWindow((unsigned int)oy, strideY, paddingY, kernelHeight, input->height, t, b);
+      // both window edges only move down: drop rows above t, add rows below the old bottom
+      for (unsigned int y = top; y < std::min(t, bottom); ++y) {
+        updateRow(y, -1);
+      }
+      for (unsigned int y = std::max(t, bottom); y < b; ++y) {
+        updateRow(y, 1);
+      }
+      top = t;
+      bottom = b;
+
+      std::fill(fine, fine + BINS, 0);
+      std::fill(coarse, coarse + COARSE, 0);
+      uint8_t* out = output->data + oy * outWidth;
+      unsigned int left = 0, right = 0;
+      for (unsigned int ox = 0; ox < outWidth; ++ox) {
+        unsigned int l, r;
+        clippedWindow(ox, strideX, paddingX, kernelWidth, width, l, r);
+        for (unsigned int x = left; x < std::min(l, right); ++x) {
+          updateColumn(x, -1);
+        }
+        for (unsigned int x = std::max(l, right); x < r; ++x) {
+          updateColumn(x, 1);
+        }
+        left = l;
+        right = r;
+
+        const unsigned int count = (r - l) * (b - t);
+        if (count == 0) {
+          out[ox] = 0;
+          continue;
+        }
+        unsigned int rank = rankOf(percentile, count);
+        unsigned int c = 0;
+        while (rank >= coarse[c]) {
+          rank -= coarse[c++];
+        }
+        unsigned int bin = c * COARSE;
+        while (rank >= fine[bin]) {
+          rank -= fine[bin++];
+        }
+        out[ox] = (uint8_t)bin;
+      }
+    }
+  });
+}
+
+void medianFilterCPU(
+    const Mat2d<uint8_t>* input,
+    const unsigned int kernelWidth,
+    const unsigned int kernelHeight,
+    Mat2d<uint8_t>* output,
+    const unsigned int strideX = 1,
+    const unsigned int strideY = 1,
+    const unsigned int paddingX = 0,
+    const unsigned int paddingY = 0) {
+  rankFilterCPU(input, kernelWidth, kernelHeight, 0.5f, output, strideX, strideY, paddingX, paddingY);
+}
+
+#endif // RANK_FILTER_HPP
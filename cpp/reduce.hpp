@@ -0,0 +1,296 @@
+#ifndef REDUCE_HPP
+#define REDUCE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+#include "mat2d.hpp"
+#include "parallel.hpp"
+
+// CPU reduction engine. Elements are widened to double and summed in 8 independent lanes (no
+// loop-carried dependency, so the loop vectorizes without -ffast-math), blocks are combined
+// pairwise, and every thread's partial is combined pairwise again. Rounding error grows with
+// log(n) instead of n as in a serial running sum.
+//
+// The fast mode splits the data into one range per thread, so the rounding (and the result bits)
+// depend on the thread count. The reproducible modes only ever sum fixed REDUCE_BLOCK blocks and
+// combine them in a tree whose shape depends on n alone; threads just evaluate disjoint subtrees.
+
+enum class ReduceMode {
+  Fast,
+  Reproducible, // same bits for any thread count
+  Compensated,  // Reproducible, with compensated (TwoSum) block sums
+};
+
+const size_t REDUCE_BLOCK = 2048;
+const unsigned int REDUCE_LANES = 8;
+
+double sumBlock(const float* data, const size_t n) {
+  double lanes[REDUCE_LANES] = {};
+  size_t i = 0;
+  for (; i + REDUCE_LANES <= n; i += REDUCE_LANES) {
+    for (unsigned int l = 0; l < REDUCE_LANES; ++l) {
+      lanes[l] += data[i + l];
+    }
+  }
+  for (unsigned int l = 0; i < n; ++i, ++l) {
+    lanes[l] += data[i];
+  }
+  return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+// Compensated summation in 8 lanes: each lane also accumulates the exact rounding error of its
+// adds (branch-free TwoSum, so the lanes still vectorize).
+double sumBlockCompensated(const float* data, const size_t n) {
+  double lanes[REDUCE_LANES] = {};
+  double errors[REDUCE_LANES] = {};
+  auto add = [&](const unsigned int l, const double v) {
+    const double t = lanes[l] + v;
+    const double z = t - lanes[l];
+    errors[l] += (lanes[l] - (t - z)) + (v - z);
+    lanes[l] = t;
+  };
+  size_t i = 0;
+  for (; i + REDUCE_LANES <= n; i += REDUCE_LANES) {
+    for (unsigned int l = 0; l < REDUCE_LANES; ++l) {
+      add(l, data[i + l]);
+    }
+  }
+  for (unsigned int l = 0; i < n; ++i, ++l) {
+    add(l, data[i]);
+  }
+  double sum = 0.0;
+  for (unsigned int l = 0; l < REDUCE_LANES; ++l) {
+    sum += lanes[l] + errors[l];
+  }
+  return sum;
+}
+
+// Max of data[0, n) in 8 lanes; -inf when n is 0, so data of only -inf gives -inf.
+float maxFloats(const float* data, const size_t n) {
+  float lanes[REDUCE_LANES];
+  std::fill(lanes, lanes + REDUCE_LANES, -INFINITY);
+  size_t i = 0;
+  for (; i + REDUCE_LANES <= n; i += REDUCE_LANES) {
+    for (unsigned int l = 0; l < REDUCE_LANES; ++l) {
+      lanes[l] = std::max(lanes[l], data[i + l]);
+    }
+  }
+  float max = -INFINITY;
+  for (; i < n; ++i) {
+    max = std::max(max, data[i]);
+  }
+  for (unsigned int l = 0; l < REDUCE_LANES; ++l) {
+    max = std::max(max, lanes[l]);
+  }
+  return max;
+}
+
+// Split point of the pairwise tree: a block boundary, so the tree shape only depends on n.
+size_t pairwiseHalf(const size_t n) {
+  return (n / REDUCE_BLOCK + 1) / 2 * REDUCE_BLOCK;
+}
+
+double sumPairwise(const float* data, const size_t n, const bool compensated = false) {
+  if (n <= REDUCE_BLOCK) {
+    return compensated ? sumBlockCompensated(data, n) : sumBlock(data, n);
+  }
+  const size_t half = pairwiseHalf(n);
+  return sumPairwise(data, half, compensated) + sumPairwise(data + half, n - half, compensated);
+}
+
+// Subtrees of the pairwise tree over n elements, cut `depth` levels below the root.
+void pairwiseSubtrees(const size_t offset, const size_t n, const unsigned int depth, std::vector<std::pair<size_t, size_t>>& subtrees) {
+  if (depth == 0 || n <= REDUCE_BLOCK) {
+    subtrees.push_back({offset, n});
+    return;
+  }
+  const size_t half = pairwiseHalf(n);
+  pairwiseSubtrees(offset, half, depth - 1, subtrees);
+  pairwiseSubtrees(offset + half, n - half, depth - 1, subtrees);
+}
+
+// Combines subtree values in the same shape pairwiseSubtrees cut them from.
+double foldPairwiseSubtrees(const size_t n, const unsigned int depth, const double*& values) {
+  if (depth == 0 || n <= REDUCE_BLOCK) {
+    return *values++;
+  }
+  const size_t half = pairwiseHalf(n);
+  const double left = foldPairwiseSubtrees(half, depth - 1, values);
+  return left + foldPairwiseSubtrees(n - half, depth - 1, values);
+}
+
+// sumPairwise(data, n) evaluated by all threads: bit-identical to the serial call.
+double sumPairwiseParallel(const float* data, const size_t n, const bool compensated) {
+  const unsigned int workers = workerCount(n, 1 << 18);
+  if (workers <= 1) {
+    return sumPairwise(data, n, compensated);
+  }
+  // several subtrees per thread; the cut does not change the result, only the load balance
+  unsigned int depth = 0;
+  while ((1u << depth) < 4 * workers) {
+    ++depth;
+  }
+  std::vector<std::pair<size_t, size_t>> subtrees;
+  pairwiseSubtrees(0, n, depth, subtrees);
+  std::vector<double> values(subtrees.size());
+  parallelForDynamic(workers, subtrees.size(), 1, [&](unsigned int, const size_t begin, const size_t end) {
+    for (size_t t = begin; t < end; ++t) {
+      values[t] = sumPairwise(data + subtrees[t].first, subtrees[t].second, compensated);
+    }
+  });
+  const double* next = values.data();
+  return foldPairwiseSubtrees(n, depth, next);
+}
+
+double combinePairwise(const double* values, const size_t n) {
+  if (n == 0) {
+    return 0.0;
+  }
+  if (n == 1) {
+    return values[0];
+  }
+  const size_t half = n / 2;
+  return combinePairwise(values, half) + combinePairwise(values + half, n - half);
+}
+
+// Sum of count floats: one contiguous range per thread in fast mode, the parallel pairwise tree otherwise.
+double reduceSumRangeCPU(const float* data, const size_t count, const ReduceMode mode = ReduceMode::Fast) {
+  if (mode != ReduceMode::Fast) {
+    return sumPairwiseParallel(data, count, mode == ReduceMode::Compensated);
+  }
+  const unsigned int workers = workerCount(count, 1 << 18);
+  std::vector<double> partials(workers);
+  parallelFor(workers, count, [&](const unsigned int worker, const size_t begin, const size_t end) {
+    partials[worker] = sumPairwise(data + begin, end - begin);
+  });
+  return combinePairwise(partials.data(), partials.size());
+}
+
+enum class ReduceAxis {
+  All,     // 1 x 1
+  Rows,    // one value per row: 1 x height
+  Columns, // one value per column: width x 1
+};
+
+enum class ReduceOp {
+  Sum,
+  Min,
+  Max,
+  Mean,
+};
+
+const unsigned int REDUCE_COLUMN_BAND = 256; // rows per partial in the reproducible column sums
+
+// Sums a Mat2d over all elements, per row or per column, writing a new Mat2d. Column sums are
+// accumulated a whole row at a time: each band of rows is added into a row of double partials
+// (contiguous, vectorized), and the band partials are combined pairwise per column. The fast mode
+// uses one band per thread; the reproducible modes use fixed REDUCE_COLUMN_BAND-row bands.
+void reduceSum2dCPU(
+    const Mat2d<float>* input,
+    const ReduceAxis axis,
+    Mat2d<float>* output,
+    const ReduceMode mode = ReduceMode::Fast) {
+  const unsigned int width = input->width;
+  const unsigned int height = input->height;
+  if (width == 0 || height == 0) {
+    std::cout << "Input must not be empty" << std::endl;
+    return;
+  }
+  const bool compensated = mode == ReduceMode::Compensated;
+
+  if (axis == ReduceAxis::All) {
+    output->width = 1;
+    output->height = 1;
+    output->data = new float[1];
+    output->data[0] = (float)reduceSumRangeCPU(input->data, (size_t)width * height, mode);
+    return;
+  }
+
+  // every mode splits rows across threads; a short, wide input parallelizes inside each row
+  // (row sums) or over column ranges (column sums) instead
+  const unsigned int workers = std::min(workerCount((size_t)width * height, 1 << 16), height);
+
+  if (axis == ReduceAxis::Rows) {
+    output->width = 1;
+    output->height = height;
+    output->data = new float[height];
+    // a row's sum is the same in both branches unless the mode is fast
+    if (workers < workerCount((size_t)width * height, 1 << 16)) {
+      for (unsigned int y = 0; y < height; ++y) {
+        output->data[y] = (float)reduceSumRangeCPU(input->data + (size_t)y * width, width, mode);
+      }
+      return;
+    }
+    parallelFor(workers, height, [&](unsigned int, const size_t begin, const size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        output->data[y] = (float)sumPairwise(input->data + y * width, width, compensated);
+      }
+    });
+    return;
+  }
+
+  output->width = width;
+  output->height = 1;
+  output->data = new float[width];
+  const bool fast = mode == ReduceMode::Fast;
+  const unsigned int bands = fast ? workers : (height + REDUCE_COLUMN_BAND - 1) / REDUCE_COLUMN_BAND;
+  // with fewer bands than threads (a short input), each band's columns are split as well; a
+  // column's partials do not depend on that split, so every mode stays reproducible
+  const unsigned int allWorkers = workerCount((size_t)width * height, 1 << 16);
+  const unsigned int columnRanges = std::min(width, (allWorkers + bands - 1) / bands);
+  const size_t items = (size_t)bands * columnRanges;
+  const unsigned int itemWorkers = (unsigned int)std::min<size_t>(allWorkers, items);
+  std::vector<double> partials((size_t)bands * width, 0.0);
+  std::vector<double> errors(compensated ? width * (size_t)itemWorkers : 0, 0.0);
+  parallelFor(itemWorkers, items, [&](const unsigned int worker, const size_t itemBegin, const size_t itemEnd) {
+    for (size_t item = itemBegin; item < itemEnd; ++item) {
+      const size_t band = item / columnRanges;
+      const size_t range = item % columnRanges;
+      const size_t x0 = width * range / columnRanges;
+      const size_t x1 = width * (range + 1) / columnRanges;
+      double* partial = partials.data() + band * width;
+      const size_t begin = fast ? height * band / bands : band * REDUCE_COLUMN_BAND;
+      const size_t end = fast ? height * (band + 1) / bands : std::min<size_t>(height, begin + REDUCE_COLUMN_BAND);
+      if (!compensated) {
+        for (size_t y = begin; y < end; ++y) {
+          const float* in = input->data + y * width;
+          for (size_t x = x0; x < x1; ++x) {
+            partial[x] += in[x];
+          }
+        }
+        continue;
+      }
+      double* error = errors.data() + (size_t)worker * width;
+      std::fill(error + x0, error + x1, 0.0);
+      for (size_t y = begin; y < end; ++y) {
+        const float* in = input->data + y * width;
+        for (size_t x = x0; x < x1; ++x) {
+          const double v = in[x];
+          const double t = partial[x] + v;
+          const double z = t - partial[x];
+          error[x] += (partial[x] - (t - z)) + (v - z);
+          partial[x] = t;
+        }
+      }
+      for (size_t x = x0; x < x1; ++x) {
+        partial[x] += error[x];
+      }
+    }
+  });
+  parallelFor(workerCount(width, 4096), width, [&](unsigned int, const size_t begin, const size_t end) {
+    std::vector<double> column(bands);
+    for (size_t x = begin; x < end; ++x) {
+      for (unsigned int b = 0; b < bands; ++b) {
+        column[b] = partials[(size_t)b * width + x];
+      }
+      output->data[x] = (float)combinePairwise(column.data(), bands);
+    }
+  });
+}
+
+#endif // REDUCE_HPP
@@ -0,0 +1,261 @@
+#ifndef REDUCTION_TREE_HPP
+#define REDUCTION_TREE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+#include "mat2d.hpp"
+#include "parallel.hpp"
+
+// Sum, min and max of a range of elements.
+struct RangeReduction {
+  double sum;
+  float min;
+  float max;
+};
+
+const unsigned int REDUCTION_TREE_LEAF = 64;
+
+// Sum, min and max of data[0, n) in 8 vectorizable lanes.
+RangeReduction reduceLeaf(const float* data, const size_t n) {
+  const unsigned int LANES = 8;
+  double sums[LANES] = {};
+  float mins[LANES], maxs[LANES];
+  std::fill(mins, mins + LANES, INFINITY);
+  std::fill(maxs, maxs + LANES, -INFINITY);
+  size_t i = 0;
+  for (; i + LANES <= n; i += LANES) {
+    for (unsigned int l = 0; l < LANES; ++l) {
+      sums[l] += data[i + l];
+      mins[l] = std::min(mins[l], data[i + l]);
+      maxs[l] = std::max(maxs[l], data[i + l]);
+    }
+  }
+  for (unsigned int l = 0; i < n; ++i, ++l) {
+    sums[l] += data[i];
+    mins[l] = std::min(mins[l], data[i]);
+    maxs[l] = std::max(maxs[l], data[i]);
+  }
+  RangeReduction r = {0.0, INFINITY, -INFINITY};
+  for (unsigned int l = 0; l < LANES; ++l) {
+    r.sum += sums[l];
+    r.min = std::min(r.min, mins[l]);
+    r.max = std::max(r.max, maxs[l]);
+  }
+  return r;
+}
+
+// Keeps a copy of a Mat2d's elements (flat, row-major indices) indexed for repeated range queries
+// while the data changes. A segment tree with lazy range adds sits over blocks of
+// REDUCTION_TREE_LEAF elements; a block is re-reduced with a vectorized scan only when an update
+// or query covers part of it. Point sets, range adds and range sum/min/max queries cost
+// O(REDUCTION_TREE_LEAF + log n) instead of a full reduceSumCPU rescan.
+//
+//   ReductionTree tree(&input);
+//   tree.add(100, 5000, 0.5f);
+//   tree.set(42, 3.0f);
+//   RangeReduction r = tree.query(0, tree.size());
+class ReductionTree {
+public:
+  explicit ReductionTree(const Mat2d<float>* input)
+      : count((size_t)input->width * input->height),
+        blocks((count + REDUCTION_TREE_LEAF - 1) / REDUCTION_TREE_LEAF),
+        values(input->data, input->data + count) {
+    while (leaves < blocks) {
+      leaves *= 2;
+    }
+    nodes.assign(2 * leaves, {0.0, INFINITY, -INFINITY, 0.0f, 0});
+    parallelFor(workerCount(blocks, 1024), blocks, [&](unsigned int, const size_t begin, const size_t end) {
+      for (size_t b = begin; b < end; ++b) {
+        refreshBlock(b);
+      }
+    });
+    for (size_t k = leaves - 1; k >= 1; --k) {
+      pull(k);
+    }
+  }
+
+  size_t size() const { return count; }
+
+  float get(const size_t i) const {
+    if (i >= count) {
+      std::cout << "Index out of range" << std::endl;
+      return 0.0f;
+    }
+    float pending = 0.0f;
+    for (size_t k = leaves + i / REDUCTION_TREE_LEAF; k >= 1; k /= 2) {
+      pending += nodes[k].pending;
+    }
+    return values[i] + pending;
+  }
+
+  void set(const size_t i, const float value) {
+    if (i >= count) {
+      std::cout << "Index out of range" << std::endl;
+      return;
+    }
+    const size_t leaf = leaves + i / REDUCTION_TREE_LEAF;
+    // push pending adds down the root-to-leaf path
+    unsigned int depth = 0;
+    while ((leaves >> depth) > 1) {
+      ++depth;
+    }
+    for (unsigned int d = depth; d >= 1; --d) {
+      push(leaf >> d);
+    }
+    flushBlock(leaf - leaves);
+    values[i] = value;
+    refreshBlock(leaf - leaves);
+    for (size_t k = leaf / 2; k >= 1; k /= 2) {
+      pull(k);
+    }
+  }
+
+  // Adds delta to every element of [begin, end).
+  void add(const size_t begin, const size_t end, const float delta) {
+    if (begin >= end || end > count) {
+      std::cout << "Range must be non-empty and inside the data" << std::endl;
+      return;
+    }
+    addRange(1, 0, leaves, begin, end, delta);
+  }
+
+  RangeReduction query(const size_t begin, const size_t end) const {
+    RangeReduction result = {0.0, INFINITY, -INFINITY};
+    if (begin >= end || end > count) {
+      std::cout << "Range must be non-empty and inside the data" << std::endl;
+      return result;
+    }
+    queryRange(1, 0, leaves, begin, end, 0.0f, result);
+    return result;
+  }
+
+  double sum(const size_t begin, const size_t end) const { return query(begin, end).sum; }
+  float min(const size_t begin, const size_t end) const { return query(begin, end).min; }
+  float max(const size_t begin, const size_t end) const { return query(begin, end).max; }
+
+private:
+  // A node's aggregates include its own pending add; its children's do not yet.
+  struct Node {
+    double sum;
+    float min;
+    float max;
+    float pending;
+    unsigned int count;
+  };
+
+  size_t count;
+  size_t blocks;
+  size_t leaves = 1; // node leaves + b is block b
+  std::vector<float> values;
+  std::vector<Node> nodes;
+
+  static void merge(RangeReduction& a, const RangeReduction& b) {
+    a.sum += b.sum;
+    a.min = std::min(a.min, b.min);
+    a.max = std::max(a.max, b.max);
+  }
+
+  void apply(const size_t k, const float delta) {
+    Node& node = nodes[k];
+    if (node.count == 0) {
+      return;
+    }
+    node.sum += (double)delta * node.count;
+    node.min += delta;
+    node.max += delta;
+    node.pending += delta;
+  }
+
+  void push(const size_t k) {
+    if (nodes[k].pending != 0.0f) {
+      apply(2 * k, nodes[k].pending);
+      apply(2 * k + 1, nodes[k].pending);
+      nodes[k].pending = 0.0f;
+    }
+  }
+
+  void pull(const size_t k) {
+    const Node& left = nodes[2 * k];
+    const Node& right = nodes[2 * k + 1];
+    nodes[k].sum = left.sum + right.sum;
+    nodes[k].min = std::min(left.min, right.min);
+    nodes[k].max = std::max(left.max, right.max);
+    nodes[k].count = left.count + right.count;
+  }
+
+  // Folds a block's pending add into its values.
+  void flushBlock(const size_t b) {
+    Node& node = nodes[leaves + b];
+    if (node.pending != 0.0f) {
+      float* data = values.data() + b * REDUCTION_TREE_LEAF;
+      for (unsigned int i = 0; i < node.count; ++i) {
+        data[i] += node.pending;
+      }
+      node.pending = 0.0f;
+    }
+  }
+
+  void refreshBlock(const size_t b) {
+    const size_t begin = b * REDUCTION_TREE_LEAF;
+    const unsigned int n = (unsigned int)std::min<size_t>(REDUCTION_TREE_LEAF, count - begin);
+    const RangeReduction r = reduceLeaf(values.data() + begin, n);
+    nodes[leaves + b] = {r.sum, r.min, r.max, 0.0f, n};
+  }
+
+  // Node k covers blocks [lo, hi).
+  void addRange(const size_t k, const size_t lo, const size_t hi, const size_t begin, const size_t end, const float delta) {
+    const size_t nodeBegin = lo * REDUCTION_TREE_LEAF;
+    const size_t nodeEnd = std::min(count, hi * REDUCTION_TREE_LEAF);
+    if (nodeBegin >= nodeEnd || end <= nodeBegin || nodeEnd <= begin) {
+      return;
+    }
+    if (begin <= nodeBegin && nodeEnd <= end) {
+      apply(k, delta);
+      return;
+    }
+    if (k >= leaves) {
+      flushBlock(lo);
+      for (size_t i = std::max(begin, nodeBegin); i < std::min(end, nodeEnd); ++i) {
+        values[i] += delta;
+      }
+      refreshBlock(lo);
+      return;
+    }
+    push(k);
+    const size_t mid = (lo + hi) / 2;
+    addRange(2 * k, lo, mid, begin, end, delta);
+    addRange(2 * k + 1, mid, hi, begin, end, delta);
+    pull(k);
+  }
+
+  // `pending` is the sum of the ancestors' pending adds, which node k's aggregates lack.
+  void queryRange(const size_t k, const size_t lo, const size_t hi, const size_t begin, const size_t end, const float pending, RangeReduction& result) const {
+    const size_t nodeBegin = lo * REDUCTION_TREE_LEAF;
+    const size_t nodeEnd = std::min(count, hi * REDUCTION_TREE_LEAF);
+    if (nodeBegin >= nodeEnd || end <= nodeBegin || nodeEnd <= begin) {
+      return;
+    }
+    const Node& node = nodes[k];
+    if (begin <= nodeBegin && nodeEnd <= end) {
+      merge(result, {node.sum + (double)pending * node.count, node.min + pending, node.max + pending});
+      return;
+    }
+    if (k >= leaves) {
+      const size_t first = std::max(begin, nodeBegin);
+      const size_t n = std::min(end, nodeEnd) - first;
+      const float shift = pending + node.pending;
+      const RangeReduction r = reduceLeaf(values.data() + first, n);
+      merge(result, {r.sum + (double)shift * n, r.min + shift, r.max + shift});
+      return;
+    }
+    const size_t mid = (lo + hi) / 2;
+    queryRange(2 * k, lo, mid, begin, end, pending + node.pending, result);
+    queryRange(2 * k + 1, mid, hi, begin, end, pending + node.pending, result);
+  }
+};
+
+#endif // REDUCTION_TREE_HPP
@@ -0,0 +1,212 @@
+#ifndef SCAN_HPP
+#define SCAN_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+#include "mat2d.hpp"
+#include "parallel.hpp"
+#include "reduce.hpp"
+
+// Prefix sums (scans) over Mat2d data. Float data is accumulated in double and rounded once per
+// element, so long scans keep float precision; integer data is accumulated in its own type.
+//
+// 1D scans are work-efficient three-phase scans: every thread totals its chunk, the chunk totals
+// are scanned, and every thread scans its chunk starting from its offset. The local scan works on
+// L1-sized blocks split into 8 segments that are scanned as 8 independent dependency chains, then
+// shifted by the running segment offsets in a vectorizable pass.
+
+template <typename T>
+using ScanAccumulator = std::conditional_t<std::is_floating_point_v<T>, double, T>;
+
+const size_t SCAN_BLOCK = 2048;
+const unsigned int SCAN_SEGMENTS = 8;
+
+template <typename T>
+ScanAccumulator<T> totalCPU(const T* data, const size_t n) {
+  using Acc = ScanAccumulator<T>;
+  Acc lanes[SCAN_SEGMENTS] = {};
+  size_t i = 0;
+  for (; i + SCAN_SEGMENTS <= n; i += SCAN_SEGMENTS) {
+    for (unsigned int l = 0; l < SCAN_SEGMENTS; ++l) {
+      lanes[l] += data[i + l];
+    }
+  }
+  Acc total = 0;
+  for (; i < n; ++i) {
+    total += data[i];
+  }
+  for (unsigned int l = 0; l < SCAN_SEGMENTS; ++l) {
+    total += lanes[l];
+  }
+  return total;
+}
+
+// Scans in[0, n) into out starting from carry and returns carry plus the total.
+template <typename T>
+ScanAccumulator<T> scanSpan(const T* in, T* out, const size_t n, ScanAccumulator<T> carry, const bool exclusive) {
+  using Acc = ScanAccumulator<T>;
+  const size_t SEGMENT = SCAN_BLOCK / SCAN_SEGMENTS;
+  Acc local[SCAN_BLOCK];
+  size_t b = 0;
+  for (; b + SCAN_BLOCK <= n; b += SCAN_BLOCK) {
+    const T* src = in + b;
+    T* dst = out + b;
+    Acc sums[SCAN_SEGMENTS] = {};
+    for (size_t j = 0; j < SEGMENT; ++j) {
+      for (unsigned int l = 0; l < SCAN_SEGMENTS; ++l) {
+        const Acc v = src[l * SEGMENT + j];
+        local[l * SEGMENT + j] = exclusive ? sums[l] : sums[l] + v;
+        sums[l] += v;
+      }
+    }
+    for (unsigned int l = 0; l < SCAN_SEGMENTS; ++l) {
+      const Acc offset = carry;
+      for (size_t j = l * SEGMENT; j < (l + 1) * SEGMENT; ++j) {
+        dst[j] = (T)(offset + local[j]);
+      }
+      carry += sums[l];
+    }
+  }
+  for (; b < n; ++b) {
+    const Acc v = in[b];
+    out[b] = (T)(exclusive ? carry : carry + v);
+    carry += v;
+  }
+  return carry;
+}
+
+// 1D scan of data[0, n), split into one chunk per thread.
+template <typename T>
+void scanRangeCPU(const T* in, T* out, const size_t n, const bool exclusive) {
+  using Acc = ScanAccumulator<T>;
+  const unsigned int workers = workerCount(n, 1 << 16);
+  if (workers <= 1) {
+    scanSpan(in, out, n, (Acc)0, exclusive);
+    return;
+  }
+  std::vector<Acc> offsets(workers);
+  parallelFor(workers, n, [&](const unsigned int worker, const size_t begin, const size_t end) {
+    offsets[worker] = totalCPU(in + begin, end - begin);
+  });
+  Acc running = 0;
+  for (Acc& offset : offsets) {
+    const Acc total = offset;
+    offset = running;
+    running += total;
+  }
+  parallelFor(workers, n, [&](const unsigned int worker, const size_t begin, const size_t end) {
+    scanSpan(in + begin, out + begin, end - begin, offsets[worker], exclusive);
+  });
+}
+
+// Scans a Mat2d: ReduceAxis::All scans the row-major flattened data, Rows scans along each row,
+// Columns scans down each column. Column scans run a whole row of running sums at a time; rows are
+// cut into one band per thread, with the same three phases as the 1D scan applied per column, and
+// a short input also splits each band's columns across threads.
+template <typename T>
+void scanCPU(
+    const Mat2d<T>* input,
+    const ReduceAxis axis,
+    Mat2d<T>* output,
+    const bool exclusive) {
+  using Acc = ScanAccumulator<T>;
+  const unsigned int width = input->width;
+  const unsigned int height = input->height;
+  if (width == 0 || height == 0) {
+    std::cout << "Input must not be empty" << std::endl;
+    return;
+  }
+  output->width = width;
+  output->height = height;
+  output->data = new T[(size_t)width * height];
+
+  if (axis == ReduceAxis::All) {
+    scanRangeCPU(input->data, output->data, (size_t)width * height, exclusive);
+    return;
+  }
+
+  const unsigned int workers = std::min(workerCount((size_t)width * height, 1 << 16), height);
+
+  if (axis == ReduceAxis::Rows) {
+    if (workers < workerCount((size_t)width * height, 1 << 16)) {
+      for (unsigned int y = 0; y < height; ++y) {
+        scanRangeCPU(input->data + (size_t)y * width, output->data + (size_t)y * width, width, exclusive);
+      }
+      return;
+    }
+    parallelFor(workers, height, [&](unsigned int, const size_t begin, const size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        scanSpan(input->data + y * width, output->data + y * width, width, (Acc)0, exclusive);
+      }
+    });
+    return;
+  }
+
+  // with fewer bands than threads (a short input), each band's columns are split into ranges as
+  // well; columns are independent, so the results do not depend on that split
+  const unsigned int allWorkers = workerCount((size_t)width * height, 1 << 16);
+  const unsigned int bands = workers;
+  const unsigned int columnRanges = std::min(width, (allWorkers + bands - 1) / bands);
+  const size_t items = (size_t)bands * columnRanges;
+  const unsigned int itemWorkers = (unsigned int)std::min<size_t>(allWorkers, items);
+  // running holds one row of sums per band: the band's column totals, then its starting row
+  std::vector<Acc> running((size_t)bands * width, (Acc)0);
+  auto forEachItem = [&](auto&& body) {
+    parallelFor(itemWorkers, items, [&](unsigned int, const size_t itemBegin, const size_t itemEnd) {
+      for (size_t item = itemBegin; item < itemEnd; ++item) {
+        const size_t band = item / columnRanges;
+        const size_t range = item % columnRanges;
+        body(running.data() + band * width, height * band / bands, height * (band + 1) / bands,
+             width * range / columnRanges, width * (range + 1) / columnRanges);
+      }
+    });
+  };
+
+  // per-band column totals, then their exclusive scan becomes each band's starting row
+  if (bands > 1) {
+    forEachItem([&](Acc* total, const size_t begin, const size_t end, const size_t x0, const size_t x1) {
+      for (size_t y = begin; y < end; ++y) {
+        const T* in = input->data + y * width;
+        for (size_t x = x0; x < x1; ++x) {
+          total[x] += in[x];
+        }
+      }
+    });
+    std::vector<Acc> carry(width, (Acc)0);
+    for (unsigned int b = 0; b < bands; ++b) {
+      Acc* total = running.data() + (size_t)b * width;
+      for (unsigned int x = 0; x < width; ++x) {
+        const Acc t = total[x];
+        total[x] = carry[x];
+        carry[x] += t;
+      }
+    }
+  }
+  forEachItem([&](Acc* sum, const size_t begin, const size_t end, const size_t x0, const size_t x1) {
+    for (size_t y = begin; y < end; ++y) {
+      const T* in = input->data + y * width;
+      T* out = output->data + y * width;
+      for (size_t x = x0; x < x1; ++x) {
+        const Acc v = in[x];
+        out[x] = (T)(exclusive ? sum[x] : sum[x] + v);
+        sum[x] += v;
+      }
+    }
+  });
+}
+
+template <typename T>
+void inclusiveScanCPU(const Mat2d<T>* input, const ReduceAxis axis, Mat2d<T>* output) {
+  scanCPU(input, axis, output, false);
+}
+
+template <typename T>
+void exclusiveScanCPU(const Mat2d<T>* input, const ReduceAxis axis, Mat2d<T>* output) {
+  scanCPU(input, axis, output, true);
+}
+
+#endif // SCAN_HPP
@@ -0,0 +1,229 @@
+#ifndef SEGMENTED_REDUCE_HPP
+#define SEGMENTED_REDUCE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include "mat2d.hpp"
+#include "parallel.hpp"
+#include "reduce.hpp"
+
+// Many reductions in one call: over variable-length segments of a packed buffer, or over the
+// elements sharing a label. Results are segmentCount x 1 (labelCount x 1) floats; an empty segment
+// or unused label gives 0 for Sum and NaN for Min, Max and Mean.
+
+const size_t SEGMENT_CHUNK = 1 << 15;
+
+double reduceIdentity(const ReduceOp op) {
+  switch (op) {
+    case ReduceOp::Min:
+      return std::numeric_limits<double>::infinity();
+    case ReduceOp::Max:
+      return -std::numeric_limits<double>::infinity();
+    default:
+      return 0.0;
+  }
+}
+
+double reduceCombine(const ReduceOp op, const double a, const double b) {
+  switch (op) {
+    case ReduceOp::Min:
+      return std::min(a, b);
+    case ReduceOp::Max:
+      return std::max(a, b);
+    default:
+      return a + b;
+  }
+}
+
+float reduceFinish(const ReduceOp op, const double value, const size_t count) {
+  if (count == 0) {
+    return op == ReduceOp::Sum ? 0.0f : NAN;
+  }
+  return (float)(op == ReduceOp::Mean ? value / count : value);
+}
+
+// Sum (for Sum and Mean), min or max of data[0, n), in 8 vectorizable lanes.
+double reduceSpan(const ReduceOp op, const float* data, const size_t n) {
+  if (op == ReduceOp::Sum || op == ReduceOp::Mean) {
+    return sumPairwise(data, n);
+  }
+  const bool isMin = op == ReduceOp::Min;
+  const float identity = isMin ? INFINITY : -INFINITY;
+  float lanes[REDUCE_LANES];
+  std::fill(lanes, lanes + REDUCE_LANES, identity);
+  size_t i = 0;
+  if (isMin) {
+    for (; i + REDUCE_LANES <= n; i += REDUCE_LANES) {
+      for (unsigned int l = 0; l < REDUCE_LANES; ++l) {
+        lanes[l] = std::min(lanes[l], data[i + l]);
+      }
+    }
+  } else {
+    for (; i + REDUCE_LANES <= n; i += REDUCE_LANES) {
+      for (unsigned int l = 0; l < REDUCE_LANES; ++l) {
+        lanes[l] = std::max(lanes[l], data[i + l]);
+      }
+    }
+  }
+  double result = identity;
+  for (; i < n; ++i) {
+    result = reduceCombine(op, result, data[i]);
+  }
+  for (unsigned int l = 0; l < REDUCE_LANES; ++l) {
+    result = reduceCombine(op, result, lanes[l]);
+  }
+  return result;
+}
+
+// Segment s is input[offsets[s], offsets[s + 1]); offsets has segmentCount + 1 non-decreasing
+// entries. Work is cut into equal element chunks handed out dynamically, not into segments, so one
+// huge segment is spread over all threads and runs of tiny segments do not pile up on one thread.
+// Segments cut by a chunk boundary leave partials that are combined in order afterwards.
+void segmentedReduceCPU(
+    const Mat2d<float>* input,
+    const size_t* offsets,
+    const unsigned int segmentCount,
+    const ReduceOp op,
+    Mat2d<float>* output) {
+  const size_t size = (size_t)input->width * input->height;
+  if (segmentCount == 0 || offsets[segmentCount] > size) {
+    std::cout << "Segments must be non-empty and inside the input" << std::endl;
+    return;
+  }
+  for (unsigned int s = 0; s < segmentCount; ++s) {
+    if (offsets[s] > offsets[s + 1]) {
+      std::cout << "Segment offsets must be non-decreasing" << std::endl;
+      return;
+    }
+  }
+  output->width = segmentCount;
+  output->height = 1;
+  output->data = new float[segmentCount];
+
+  parallelFor(workerCount(segmentCount, 1 << 16), segmentCount, [&](unsigned int, const size_t begin, const size_t end) {
+    for (size_t s = begin; s < end; ++s) {
+      if (offsets[s] == offsets[s + 1]) {
+        output->data[s] = reduceFinish(op, reduceIdentity(op), 0);
+      }
+    }
+  });
+
+  struct Partial {
+    unsigned int segment;
+    double value;
+  };
+  const unsigned int NONE = std::numeric_limits<unsigned int>::max();
+  const size_t first = offsets[0];
+  const size_t total = offsets[segmentCount] - first;
+  const size_t chunks = (total + SEGMENT_CHUNK - 1) / SEGMENT_CHUNK;
+  // slot 0: the segment running in from the previous chunk, slot 1: the one running out
+  std::vector<Partial> partials(2 * chunks, {NONE, 0.0});
+
+  parallelForDynamic(workerCount(chunks), chunks, 1, [&](unsigned int, const size_t chunkBegin, const size_t chunkEnd) {
+    for (size_t c = chunkBegin; c < chunkEnd; ++c) {
+      const size_t begin = first + c * SEGMENT_CHUNK;
+      const size_t end = std::min(begin + SEGMENT_CHUNK, first + total);
+      // last segment starting at or before `begin`, which is the non-empty one holding it
+      unsigned int s = (unsigned int)(std::upper_bound(offsets, offsets + segmentCount + 1, begin) - offsets) - 1;
+      for (size_t i = begin; i < end; ++s) {
+        if (offsets[s + 1] <= i) {
+          continue;
+        }
+        const size_t stop = std::min(end, offsets[s + 1]);
+        const double value = reduceSpan(op, input->data + i, stop - i);
+        if (offsets[s] >= begin && offsets[s + 1] <= end) {
+          output->data[s] = reduceFinish(op, value, offsets[s + 1] - offsets[s]);
+        } else {
+          partials[2 * c + (offsets[s] < begin ? 0 : 1)] = {s, value};
+        }
+        i = stop;
+      }
+    }
+  });
+
+  // partials of one segment are adjacent in chunk order, apart from unused slots
+  unsigned int segment = NONE;
+  double value = 0.0;
+  for (const Partial& partial : partials) {
+    if (partial.segment == NONE) {
+      continue;
+    }
+    if (partial.segment == segment) {
+      value = reduceCombine(op, value, partial.value);
+      continue;
+    }
+    if (segment != NONE) {
+      output->data[segment] = reduceFinish(op, value, offsets[segment + 1] - offsets[segment]);
+    }
+    segment = partial.segment;
+    value = partial.value;
+  }
+  if (segment != NONE) {
+    output->data[segment] = reduceFinish(op, value, offsets[segment + 1] - offsets[segment]);
+  }
+}
+
+// Reduces input elements by label (e.g. connected-component statistics); labels must have the
+// input's shape, and labels >= labelCount are skipped. Every thread accumulates its contiguous range
+// into private per-label partials, so cost follows element count however skewed the label sizes
+// are. Runs of equal labels are reduced in registers first and touch their partial once.
+void keyedReduceCPU(
+    const Mat2d<float>* input,
+    const Mat2d<uint32_t>* labels,
+    const unsigned int labelCount,
+    const ReduceOp op,
+    Mat2d<float>* output) {
+  if (labels->width != input->width || labels->height != input->height) {
+    std::cout << "Labels must have the input's shape" << std::endl;
+    return;
+  }
+  if (labelCount == 0) {
+    std::cout << "Label count must be positive" << std::endl;
+    return;
+  }
+  const size_t size = (size_t)input->width * input->height;
+  const unsigned int workers = workerCount(size, std::max<size_t>(1 << 16, (size_t)labelCount * 4));
+  std::vector<double> values((size_t)workers * labelCount, reduceIdentity(op));
+  std::vector<size_t> counts((size_t)workers * labelCount, 0);
+
+  parallelFor(workers, size, [&](const unsigned int worker, const size_t begin, const size_t end) {
+    double* value = values.data() + (size_t)worker * labelCount;
+    size_t* count = counts.data() + (size_t)worker * labelCount;
+    const uint32_t* label = labels->data;
+    for (size_t i = begin; i < end;) {
+      const uint32_t l = label[i];
+      size_t j = i + 1;
+      while (j < end && label[j] == l) {
+        ++j;
+      }
+      if (l < labelCount) {
+        value[l] = reduceCombine(op, value[l], reduceSpan(op, input->data + i, j - i));
+        count[l] += j - i;
+      }
+      i = j;
+    }
+  });
+
+  output->width = labelCount;
+  output->height = 1;
+  output->data = new float[labelCount];
+  parallelFor(workerCount(labelCount, 4096), labelCount, [&](unsigned int, const size_t begin, const size_t end) {
+    for (size_t l = begin; l < end; ++l) {
+      double value = reduceIdentity(op);
+      size_t count = 0;
+      for (unsigned int w = 0; w < workers; ++w) {
+        value = reduceCombine(op, value, values[(size_t)w * labelCount + l]);
+        count += counts[(size_t)w * labelCount + l];
+      }
+      output->data[l] = reduceFinish(op, value, count);
+    }
+  });
+}
+
+#endif // SEGMENTED_REDUCE_HPP
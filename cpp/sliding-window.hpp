@@ -0,0 +1,136 @@
+#ifndef SLIDING_WINDOW_HPP
+#define SLIDING_WINDOW_HPP
+
+#include <cstddef>
+#include <iostream>
+
+#include "reduce.hpp"
+
+// Per-sample outputs of SlidingWindowReduction::push; any of them may be null.
+struct WindowOutputs {
+  float* sum = nullptr;
+  float* mean = nullptr;
+  float* min = nullptr;
+  float* max = nullptr;
+};
+
+// Rolling sum, mean, min and max over the latest `window` samples of a stream that arrives in
+// chunks of any size. Output t covers samples (t - window, t]; until `window` samples have arrived
+// it covers all of them. O(1) amortized per sample, and no allocation after construction.
+//
+// The sum is a running double sum, re-normalized to an exact pairwise sum of the ring every time
+// the ring wraps (every `window` samples), so rounding error cannot drift over a long stream.
+// Min and max use monotonic deques of (sample index, value).
+//
+//   SlidingWindowReduction rolling(1000);
+//   WindowOutputs out;
+//   out.mean = means;
+//   rolling.push(chunk, chunkSize, out); // means[i] is the mean of the window ending at chunk[i]
+class SlidingWindowReduction {
+public:
+  explicit SlidingWindowReduction(const size_t window)
+      : window(window) {
+    if (window == 0) {
+      std::cout << "Window must not be empty" << std::endl;
+      return;
+    }
+    ring = new float[window];
+    minIndex = new size_t[window];
+    minValue = new float[window];
+    maxIndex = new size_t[window];
+    maxValue = new float[window];
+  }
+
+  ~SlidingWindowReduction() {
+    delete[] ring;
+    delete[] minIndex;
+    delete[] minValue;
+    delete[] maxIndex;
+    delete[] maxValue;
+  }
+
+  SlidingWindowReduction(const SlidingWindowReduction&) = delete;
+  SlidingWindowReduction& operator=(const SlidingWindowReduction&) = delete;
+
+  size_t windowSize() const { return window; }
+  size_t samplesReceived() const { return received; }
+
+  void reset() {
+    received = 0;
+    sum = 0.0;
+    minHead = minSize = 0;
+    maxHead = maxSize = 0;
+  }
+
+  void push(const float* samples, const size_t n, const WindowOutputs& out) {
+    if (!ring) {
+      return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      const float v = samples[i];
+      const size_t t = received++;
+      const size_t slot = t % window;
+      if (t >= window) {
+        sum -= ring[slot];
+      }
+      ring[slot] = v;
+      sum += v;
+      if (slot == window - 1) {
+        sum = sumPairwise(ring, window);
+      }
+
+      // drop the expired front, then everything at the back the new sample dominates
+      if (minSize > 0 && minIndex[minHead] + window <= t) {
+        minHead = (minHead + 1) % window;
+        --minSize;
+      }
+      while (minSize > 0 && minValue[(minHead + minSize - 1) % window] >= v) {
+        --minSize;
+      }
+      minIndex[(minHead + minSize) % window] = t;
+      minValue[(minHead + minSize) % window] = v;
+      ++minSize;
+
+      if (maxSize > 0 && maxIndex[maxHead] + window <= t) {
+        maxHead = (maxHead + 1) % window;
+        --maxSize;
+      }
+      while (maxSize > 0 && maxValue[(maxHead + maxSize - 1) % window] <= v) {
+        --maxSize;
+      }
+      maxIndex[(maxHead + maxSize) % window] = t;
+      maxValue[(maxHead + maxSize) % window] = v;
+      ++maxSize;
+
+      if (out.sum) {
+        out.sum[i] = (float)sum;
+      }
+      if (out.mean) {
+        out.mean[i] = (float)(sum / (t < window ? t + 1 : window));
+      }
+      if (out.min) {
+        out.min[i] = minValue[minHead];
+      }
+      if (out.max) {
+        out.max[i] = maxValue[maxHead];
+      }
+    }
+  }
+
+private:
+  size_t window;
+  size_t received = 0;
+  double sum = 0.0;
+  float* ring = nullptr;
+  // monotonic deques as rings of `window` entries: head is the oldest entry and the window's extreme
+  size_t* minIndex = nullptr;
+  float* minValue = nullptr;
+  size_t minHead = 0;
+  size_t minSize = 0;
+  size_t* maxIndex = nullptr;
+  float* maxValue = nullptr;
+  size_t maxHead = 0;
+  size_t maxSize = 0;
+};
+
+#endif // SLIDING_WINDOW_HPP
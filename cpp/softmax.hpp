@@ -0,0 +1,163 @@
+#ifndef SOFTMAX_HPP
+#define SOFTMAX_HPP
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+#include "activation.hpp"
+#include "mat2d.hpp"
+#include "parallel.hpp"
+#include "reduce.hpp"
+
+// Row-wise softmax and log-softmax of a Mat2d<float>, with activationExpFlushed from
+// activation.hpp. Softmax outputs of at least FLT_MIN are within 4e-6 relative error of a double
+// reference (most of it the float rounding of x - max). exp is flushed to 0 for x - max below
+// -87.3, so masked (-inf) entries come out as exactly 0. Log-softmax is within 1e-7. A row of only -inf gives NaN.
+// Online formulation: a single pass over the input keeps a running max and a sum of exp(x - max)
+// rescaled whenever the max grows, so the input is read once for both.
+//
+// The pass works in SOFTMAX_BLOCK blocks: the block max (a vectorized max) updates the running max
+// once per block, and the block's exps are taken against it. Softmax stores those exps and the
+// max each block used, so its second pass is a single multiply per element, not another exp.
+
+const unsigned int SOFTMAX_BLOCK = 256;
+
+struct SoftmaxState {
+  float max;
+  double sum; // of exp(x - max)
+};
+
+void mergeSoftmax(SoftmaxState& a, const SoftmaxState& b) {
+  const float max = std::max(a.max, b.max);
+  a.sum = a.sum * std::exp((double)a.max - max) + b.sum * std::exp((double)b.max - max);
+  a.max = max;
+}
+
+// First pass over in[0, n), n a multiple of SOFTMAX_BLOCK except at the end of a row. With STORE,
+// out gets exp(x - refs[k]) for every x of block k.
+template <bool STORE>
+SoftmaxState softmaxScan(const float* in, const size_t n, float* out, float* refs) {
+  const unsigned int LANES = 8;
+  SoftmaxState state = {-FLT_MAX, 0.0};
+  for (size_t b = 0, k = 0; b < n; b += SOFTMAX_BLOCK, ++k) {
+    const size_t len = std::min<size_t>(SOFTMAX_BLOCK, n - b);
+    const float blockMax = maxFloats(in + b, len);
+    if (blockMax > state.max) {
+      state.sum *= std::exp((double)state.max - blockMax);
+      state.max = blockMax;
+    }
+    const float max = state.max;
+    float lanes[LANES] = {};
+    size_t i = 0;
+    for (; i + LANES <= len; i += LANES) {
+      for (unsigned int l = 0; l < LANES; ++l) {
+        const float e = activationExpFlushed(in[b + i + l] - max);
+        if constexpr (STORE) {
+          out[b + i + l] = e;
+        }
+        lanes[l] += e;
+      }
+    }
+    for (; i < len; ++i) {
+      const float e = activationExpFlushed(in[b + i] - max);
+      if constexpr (STORE) {
+        out[b + i] = e;
+      }
+      lanes[0] += e;
+    }
+    double sum = 0.0;
+    for (unsigned int l = 0; l < LANES; ++l) {
+      sum += lanes[l];
+    }
+    state.sum += sum;
+    if constexpr (STORE) {
+      refs[k] = max;
+    }
+  }
+  return state;
+}
+
+// Second pass over the blocks [0, n) of one row once its final state is known.
+template <bool LOG>
+void softmaxFinish(const float* in, float* out, const size_t n, const float* refs, const SoftmaxState& state) {
+  if constexpr (LOG) {
+    const float shift = (float)(state.max + std::log(state.sum));
+    for (size_t i = 0; i < n; ++i) {
+      out[i] = in[i] - shift;
+    }
+  } else {
+    for (size_t b = 0, k = 0; b < n; b += SOFTMAX_BLOCK, ++k) {
+      const size_t end = std::min<size_t>(n, b + SOFTMAX_BLOCK);
+      const float scale = (float)(std::exp((double)refs[k] - state.max) / state.sum);
+      for (size_t i = b; i < end; ++i) {
+        out[i] *= scale;
+      }
+    }
+  }
+}
+
+// Rows are split across threads; when there are fewer rows than threads, each row is split into
+// block-aligned chunks instead, and the chunks' (max, sum) states are merged.
+template <bool LOG>
+void softmaxRowsCPU(const Mat2d<float>* input, Mat2d<float>* output) {
+  const unsigned int width = input->width;
+  const unsigned int height = input->height;
+  if (width == 0 || height == 0) {
+    std::cout << "Input must not be empty" << std::endl;
+    return;
+  }
+  output->width = width;
+  output->height = height;
+  output->data = new float[(size_t)width * height];
+  const size_t blocks = (width + SOFTMAX_BLOCK - 1) / SOFTMAX_BLOCK;
+  const unsigned int rowWorkers = std::min(workerCount((size_t)width * height, 1 << 15), height);
+
+  if (rowWorkers >= workerCount((size_t)width * height, 1 << 15)) {
+    parallelFor(rowWorkers, height, [&](unsigned int, const size_t begin, const size_t end) {
+      std::vector<float> refs(LOG ? 0 : blocks);
+      for (size_t y = begin; y < end; ++y) {
+        const float* in = input->data + y * width;
+        float* out = output->data + y * width;
+        const SoftmaxState state = softmaxScan<!LOG>(in, width, out, refs.data());
+        softmaxFinish<LOG>(in, out, width, refs.data(), state);
+      }
+    });
+    return;
+  }
+
+  const unsigned int workers = workerCount(width, 1 << 15);
+  std::vector<float> refs(LOG ? 0 : blocks);
+  std::vector<SoftmaxState> states(workers);
+  for (unsigned int y = 0; y < height; ++y) {
+    const float* in = input->data + (size_t)y * width;
+    float* out = output->data + (size_t)y * width;
+    parallelFor(workers, blocks, [&](const unsigned int worker, const size_t begin, const size_t end) {
+      const size_t first = begin * SOFTMAX_BLOCK;
+      const size_t last = std::min<size_t>(width, end * SOFTMAX_BLOCK);
+      states[worker] = softmaxScan<!LOG>(in + first, last - first, out + first, refs.data() + begin);
+    });
+    SoftmaxState state = states[0];
+    for (unsigned int w = 1; w < workers; ++w) {
+      mergeSoftmax(state, states[w]);
+    }
+    parallelFor(workers, blocks, [&](unsigned int, const size_t begin, const size_t end) {
+      const size_t first = begin * SOFTMAX_BLOCK;
+      const size_t last = std::min<size_t>(width, end * SOFTMAX_BLOCK);
+      softmaxFinish<LOG>(in + first, out + first, last - first, refs.data() + begin, state);
+    });
+  }
+}
+
+void softmaxCPU(const Mat2d<float>* input, Mat2d<float>* output) {
+  softmaxRowsCPU<false>(input, output);
+}
+
+void logSoftmaxCPU(const Mat2d<float>* input, Mat2d<float>* output) {
+  softmaxRowsCPU<true>(input, output);
+}
+
+#endif // SOFTMAX_HPP
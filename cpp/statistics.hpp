@@ -0,0 +1,179 @@
+#ifndef STATISTICS_HPP
+#define STATISTICS_HPP
+
+#include <algorithm>
+#include <cfloat>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+#include "mat2d.hpp"
+#include "parallel.hpp"
+#include "reduce.hpp"
+
+// Min, max, their first flat indices, mean and population variance of a whole Mat2d.
+struct Statistics {
+  size_t count;
+  float min;
+  float max;
+  size_t argmin;
+  size_t argmax;
+  double mean;
+  double m2; // sum of squared deviations from the mean
+  double variance;
+};
+
+// Chan et al. parallel merge of (count, mean, m2); b must come after a in index order so ties on
+// min/max keep the first index.
+void mergeStatistics(Statistics& a, const Statistics& b) {
+  if (b.count == 0) {
+    return;
+  }
+  if (a.count == 0) {
+    a = b;
+    return;
+  }
+  if (b.min < a.min) {
+    a.min = b.min;
+    a.argmin = b.argmin;
+  }
+  if (b.max > a.max) {
+    a.max = b.max;
+    a.argmax = b.argmax;
+  }
+  const double count = (double)a.count + b.count;
+  const double delta = b.mean - a.mean;
+  a.mean += delta * (b.count / count);
+  a.m2 += b.m2 + delta * delta * ((double)a.count * b.count / count);
+  a.count += b.count;
+}
+
+// One cache-resident block: min/max/argmin/argmax and the sum in 8 lanes, then m2 around the block
+// mean in a second sweep of the same (L1-resident) block. Memory is still read once.
+Statistics blockStatistics(const float* data, const unsigned int n, const size_t offset) {
+  const unsigned int LANES = 8;
+  // lanes start from the first element (index 0), not a sentinel, so all-infinite data keeps its
+  // true min and max
+  float lmin[LANES], lmax[LANES];
+  unsigned int lminIndex[LANES] = {}, lmaxIndex[LANES] = {};
+  double lsum[LANES] = {};
+  for (unsigned int l = 0; l < LANES; ++l) {
+    lmin[l] = data[0];
+    lmax[l] = data[0];
+  }
+
+  auto step = [&](const unsigned int i, const unsigned int l) {
+    const float v = data[i];
+    const bool lower = v < lmin[l];
+    const bool higher = v > lmax[l];
+    lmin[l] = lower ? v : lmin[l];
+    lminIndex[l] = lower ? i : lminIndex[l];
+    lmax[l] = higher ? v : lmax[l];
+    lmaxIndex[l] = higher ? i : lmaxIndex[l];
+    lsum[l] += v;
+  };
+  unsigned int i = 0;
+  for (; i + LANES <= n; i += LANES) {
+    for (unsigned int l = 0; l < LANES; ++l) {
+      step(i + l, l);
+    }
+  }
+  for (unsigned int l = 0; i < n; ++i, ++l) {
+    step(i, l);
+  }
+
+  Statistics s = {n, data[0], data[0], offset, offset, 0.0, 0.0, 0.0};
+  unsigned int minIndex = 0, maxIndex = 0;
+  double sum = 0.0;
+  for (unsigned int l = 0; l < LANES; ++l) {
+    if (lmin[l] < s.min || (lmin[l] == s.min && lminIndex[l] < minIndex)) {
+      s.min = lmin[l];
+      minIndex = lminIndex[l];
+    }
+    if (lmax[l] > s.max || (lmax[l] == s.max && lmaxIndex[l] < maxIndex)) {
+      s.max = lmax[l];
+      maxIndex = lmaxIndex[l];
+    }
+    sum += lsum[l];
+  }
+  s.argmin = offset + minIndex;
+  s.argmax = offset + maxIndex;
+  s.mean = sum / n;
+
+  double lm2[LANES] = {};
+  const double mean = s.mean;
+  i = 0;
+  for (; i + LANES <= n; i += LANES) {
+    for (unsigned int l = 0; l < LANES; ++l) {
+      const double d = data[i + l] - mean;
+      lm2[l] += d * d;
+    }
+  }
+  for (unsigned int l = 0; i < n; ++i, ++l) {
+    const double d = data[i] - mean;
+    lm2[l] += d * d;
+  }
+  for (unsigned int l = 0; l < LANES; ++l) {
+    s.m2 += lm2[l];
+  }
+  return s;
+}
+
+// Statistics of data[begin, end), block by block in index order.
+Statistics rangeStatistics(const float* data, const size_t begin, const size_t end) {
+  Statistics s = {0, FLT_MAX, -FLT_MAX, 0, 0, 0.0, 0.0, 0.0};
+  for (size_t b = begin; b < end; b += REDUCE_BLOCK) {
+    const unsigned int n = (unsigned int)std::min(REDUCE_BLOCK, end - b);
+    mergeStatistics(s, blockStatistics(data + b, n, b));
+  }
+  return s;
+}
+
+// Merges blocks[0, n) in a pairwise tree whose shape only depends on n.
+Statistics mergePairwise(const Statistics* blocks, const size_t n) {
+  if (n == 1) {
+    return blocks[0];
+  }
+  const size_t half = n / 2;
+  Statistics a = mergePairwise(blocks, half);
+  mergeStatistics(a, mergePairwise(blocks + half, n - half));
+  return a;
+}
+
+// All statistics in one multi-threaded pass over the data; per-thread results are merged in
+// index order with the numerically stable Chan/Welford update. The reproducible modes compute
+// every REDUCE_BLOCK block on its own and merge the blocks in a fixed pairwise tree instead, so
+// the bits do not depend on the thread count; block sums are short double sums already, so
+// Compensated gives the same result as Reproducible.
+Statistics statisticsCPU(const Mat2d<float>* input, const ReduceMode mode = ReduceMode::Fast) {
+  const size_t size = (size_t)input->width * input->height;
+  Statistics result = {0, FLT_MAX, -FLT_MAX, 0, 0, 0.0, 0.0, 0.0};
+  if (size == 0) {
+    std::cout << "Input must not be empty" << std::endl;
+    return result;
+  }
+  const unsigned int workers = workerCount(size, 1 << 16);
+  if (mode == ReduceMode::Fast) {
+    std::vector<Statistics> partials(workers);
+    parallelFor(workers, size, [&](const unsigned int worker, const size_t begin, const size_t end) {
+      partials[worker] = rangeStatistics(input->data, begin, end);
+    });
+    for (const Statistics& partial : partials) {
+      mergeStatistics(result, partial);
+    }
+  } else {
+    const size_t blocks = (size + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+    std::vector<Statistics> partials(blocks);
+    parallelFor(workers, blocks, [&](unsigned int, const size_t begin, const size_t end) {
+      for (size_t b = begin; b < end; ++b) {
+        const size_t offset = b * REDUCE_BLOCK;
+        partials[b] = blockStatistics(input->data + offset, (unsigned int)std::min(REDUCE_BLOCK, size - offset), offset);
+      }
+    });
+    result = mergePairwise(partials.data(), blocks);
+  }
+  result.variance = result.m2 / result.count;
+  return result;
+}
+
+#endif // STATISTICS_HPP
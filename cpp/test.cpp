@@ -0,0 +1,156 @@
+#include "activation.hpp"
+#include "morphology.hpp"
+#include "normalization.hpp"
+#include "pooling.hpp"
+#include "rank-filter.hpp"
+#include <cmath>
+#include <cstdio>
+
+// Regression checks for the CPU operators that do not need Metal. Prints every failed check and
+// exits with the number of failures.
+
+int failures = 0;
+
+void check(const bool ok, const char* what) {
+  if (!ok) {
+    printf("FAILED: %s\n", what);
+    ++failures;
+  }
+}
+
+// Opening must never exceed the input and closing never fall below it, whatever the mask shape.
+void testMorphologyAsymmetricMask() {
+  float rowArray[] = {0, 5, 5, 0, 0, 0};
+  const Mat2d<float> row = {rowArray, 6, 1};
+  float pairArray[] = {1, 1};
+  const Mat2d<float> pair = {pairArray, 2, 1};
+
+  Mat2d<float> opened, closed;
+  openingCPU(&row, &pair, &opened);
+  closingCPU(&row, &pair, &closed);
+  const float expectedOpening[] = {0, 5, 5, 0, 0, 0};
+  for (unsigned int x = 0; x < row.width; ++x) {
+    check(opened.data[x] == expectedOpening[x], "opening with a 1 x 2 mask keeps a 2-wide plateau");
+    check(closed.data[x] >= rowArray[x], "closing with a 1 x 2 mask is extensive");
+  }
+  delete[] opened.data;
+  delete[] closed.data;
+
+  const unsigned int width = 37;
+  const unsigned int height = 23;
+  float* imageArray = new float[width * height];
+  for (unsigned int i = 0; i < width * height; ++i) {
+    imageArray[i] = (float)((i * 7919u) % 101);
+  }
+  const Mat2d<float> image = {imageArray, width, height};
+  // L-shaped, even-size mask: no symmetry for the reflection to hide behind
+  float lArray[] = {1, 0, 0, 0,
+                    1, 0, 0, 0,
+                    1, 1, 1, 0};
+  const Mat2d<float> l = {lArray, 4, 3};
+  openingCPU(&image, &l, &opened);
+  closingCPU(&image, &l, &closed);
+  bool ordered = true;
+  for (unsigned int i = 0; i < width * height; ++i) {
+    ordered = ordered && opened.data[i] <= imageArray[i] && imageArray[i] <= closed.data[i];
+  }
+  check(ordered, "opening <= input <= closing with an asymmetric 4 x 3 mask");
+  delete[] opened.data;
+  delete[] closed.data;
+  delete[] imageArray;
+}
+
+// tanh keeps its relative precision near 0, SiLU and GELU go to 0 for very negative inputs, and
+// NaN is never hidden behind the exp clamp.
+void testActivationSmallInputsAndNaN() {
+  for (const float x : {1e-30f, 1e-8f, 1e-4f, -3e-3f, 0.3f, -0.59f}) {
+    const double expected = std::tanh((double)x);
+    check(std::fabs(activationTanh(x) - expected) <= 3e-7 * std::fabs(expected), "tanh relative error near 0");
+  }
+  // very negative inputs go to 0 instead of x times the saturated exp(-87.3)
+  for (const float x : {-15.0f, -60.0f, -87.0f}) {
+    const double expected = x / (1.0 + std::exp(-(double)x));
+    check(std::fabs(activationSilu(x) - expected) <= 4e-7 * std::fabs(expected), "SiLU relative error at large negative x");
+  }
+  for (const float x : {-100.0f, -1e4f, -INFINITY}) {
+    check(activationSigmoid(x) == 0.0f && activationSilu(x) == 0.0f, "sigmoid and SiLU flush to 0 below -87.3");
+  }
+  check(std::fabs(activationGelu(-10.008f)) < 1e-36f && activationGelu(-INFINITY) == 0.0f, "GELU flushes to 0 at large negative x");
+  float nan = NAN;
+  for (unsigned int a = 0; a <= (unsigned int)Activation::SiLU; ++a) {
+    float y = 0.0f;
+    applyActivation(&nan, &y, 1, (Activation)a, 0.01f);
+    check(std::isnan(y), "activation of NaN is NaN");
+  }
+}
+
+// A row far from zero relative to its spread: normalizing must not cancel the mean in float.
+void testLayerNormLargeOffset() {
+  const unsigned int width = 1024;
+  float* rowArray = new float[width];
+  for (unsigned int x = 0; x < width; ++x) {
+    rowArray[x] = 1e4f + 0.03f * ((float)((x * 37u) % 201) / 100.0f - 1.0f);
+  }
+  const Mat2d<float> row = {rowArray, width, 1};
+  double mean = 0.0;
+  for (unsigned int x = 0; x < width; ++x) {
+    mean += rowArray[x];
+  }
+  mean /= width;
+  double variance = 0.0;
+  for (unsigned int x = 0; x < width; ++x) {
+    variance += (rowArray[x] - mean) * (rowArray[x] - mean);
+  }
+  variance /= width;
+
+  Mat2d<float> normalized;
+  layerNormCPU(&row, nullptr, nullptr, &normalized);
+  double worst = 0.0;
+  for (unsigned int x = 0; x < width; ++x) {
+    const double expected = (rowArray[x] - mean) / std::sqrt(variance + 1e-5);
+    worst = std::max(worst, std::fabs(normalized.data[x] - expected));
+  }
+  check(worst < 1e-5, "layer norm of a row at 1e4 +- 0.03");
+  delete[] normalized.data;
+  delete[] rowArray;
+}
+
+// The max of an input of only -inf is -inf, not the -FLT_MAX a finite seed would give.
+void testGlobalMaxPoolOfInfinities() {
+  const unsigned int size = 1000;
+  float* array = new float[size];
+  std::fill(array, array + size, -INFINITY);
+  const Mat2d<float> input = {array, size, 1};
+  check(globalMaxPoolCPU(&input) == -INFINITY, "global max pool of only -inf");
+  array[size - 1] = -FLT_MAX;
+  check(globalMaxPoolCPU(&input) == -FLT_MAX, "global max pool of -inf and -FLT_MAX");
+  delete[] array;
+}
+
+// A NaN that slides through the window must leave it again, and windows in the padding give 0.
+void testRankFilterNaN() {
+  float rowArray[] = {1, NAN, 2, 3, 4, 5, -NAN, 6, 7, 8};
+  const Mat2d<float> row = {rowArray, 10, 1};
+  Mat2d<float> filtered;
+  rankFilterCPU(&row, 3, 1, 1.0f, &filtered, 1, 1, 0, 1);
+  const float expected[] = {NAN, NAN, 4, 5, NAN, NAN, NAN, 8};
+  check(filtered.width == 8 && filtered.height == 3, "rank filter output shape");
+  for (unsigned int x = 0; x < filtered.width; ++x) {
+    check(filtered.data[x] == 0.0f && filtered.data[2 * filtered.width + x] == 0.0f, "rank filter of padding rows is 0");
+    const float y = filtered.data[filtered.width + x];
+    check(std::isnan(expected[x]) ? std::isnan(y) : y == expected[x], "rank filter max ranks NaN highest and drops it");
+  }
+  delete[] filtered.data;
+}
+
+int main() {
+  testMorphologyAsymmetricMask();
+  testActivationSmallInputsAndNaN();
+  testLayerNormLargeOffset();
+  testGlobalMaxPoolOfInfinities();
+  testRankFilterNaN();
+  if (failures == 0) {
+    printf("all tests passed\n");
+  }
+  return failures;
+}
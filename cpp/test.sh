@@ -0,0 +1,3 @@
+#!/bin/bash
+
+clang++ -O3 -std=c++2b test.cpp -o test && ./test
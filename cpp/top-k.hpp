@@ -0,0 +1,169 @@
+#ifndef TOP_K_HPP
+#define TOP_K_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "histogram.hpp"
+#include "mat2d.hpp"
+#include "parallel.hpp"
+
+// Top-k selection: the k largest values of a Mat2d<float> and their flat indices, as k x 1 Mat2ds
+// sorted from largest to smallest. Equal values keep the lower index first. Values are compared
+// through an order-preserving uint32 key that maps every NaN, whatever its sign, to the largest
+// key, so NaNs rank above +inf and tie with each other.
+
+const unsigned int TOP_K_HEAP_MAX = 1024; // larger k goes through radix select
+const unsigned int TOP_K_FILTER_BLOCK = 64;
+
+struct TopKEntry {
+  uint32_t key;
+  uint32_t index;
+};
+
+inline uint32_t topKKey(const float v) {
+  const uint32_t bits = std::bit_cast<uint32_t>(v);
+  const uint32_t key = bits ^ ((uint32_t)((int32_t)bits >> 31) | 0x80000000u);
+  return key | (0u - (uint32_t)((bits & 0x7fffffffu) > 0x7f800000u));
+}
+
+// a ranks before b
+inline bool topKBefore(const TopKEntry& a, const TopKEntry& b) {
+  return a.key > b.key || (a.key == b.key && a.index < b.index);
+}
+
+// Every thread keeps a bounded heap of its k best entries. A block whose largest key does not beat
+// the heap's worst entry is skipped after one vectorizable max pass, so once the heap warms up almost
+// all of the input is only read once and never touches the heap.
+void topKHeapCPU(const float* data, const size_t size, const unsigned int k, std::vector<TopKEntry>& result) {
+  const unsigned int workers = workerCount(size, std::max<size_t>(1 << 16, (size_t)k * 64));
+  std::vector<std::vector<TopKEntry>> heaps(workers);
+  parallelFor(workers, size, [&](const unsigned int worker, const size_t begin, const size_t end) {
+    std::vector<TopKEntry>& heap = heaps[worker];
+    heap.reserve(k);
+    auto consider = [&](const size_t i) {
+      const TopKEntry entry = {topKKey(data[i]), (uint32_t)i};
+      if (heap.size() < k) {
+        heap.push_back(entry);
+        std::push_heap(heap.begin(), heap.end(), topKBefore);
+      } else if (entry.key > heap.front().key) {
+        // entries come in index order, so an equal key never displaces the heap's worst entry
+        std::pop_heap(heap.begin(), heap.end(), topKBefore);
+        heap.back() = entry;
+        std::push_heap(heap.begin(), heap.end(), topKBefore);
+      }
+    };
+    size_t i = begin;
+    for (; i + TOP_K_FILTER_BLOCK <= end; i += TOP_K_FILTER_BLOCK) {
+      uint32_t blockMax = 0;
+      for (unsigned int j = 0; j < TOP_K_FILTER_BLOCK; ++j) {
+        blockMax = std::max(blockMax, topKKey(data[i + j]));
+      }
+      if (heap.size() == k && blockMax <= heap.front().key) {
+        continue;
+      }
+      for (unsigned int j = 0; j < TOP_K_FILTER_BLOCK; ++j) {
+        consider(i + j);
+      }
+    }
+    for (; i < end; ++i) {
+      consider(i);
+    }
+  });
+
+  result.clear();
+  for (const std::vector<TopKEntry>& heap : heaps) {
+    result.insert(result.end(), heap.begin(), heap.end());
+  }
+  std::partial_sort(result.begin(), result.begin() + k, result.end(), topKBefore);
+  result.resize(k);
+}
+
+// Radix select on the keys, 8 bits per pass: a histogram of the next digit among the elements that
+// still match the selected prefix picks the digit holding the k-th largest key. It stops early once
+// the selected bucket is taken whole. A last pass collects every element above the prefix and the
+// first matching ones in index order.
+void topKRadixCPU(const Mat2d<float>* input, const unsigned int k, std::vector<TopKEntry>& result) {
+  const float* data = input->data;
+  const size_t size = (size_t)input->width * input->height;
+  uint32_t prefix = 0;
+  uint32_t mask = 0;
+  size_t needed = k;
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    Mat2d<uint32_t> counts;
+    privatizedHistogramCPU(input, 256, [=](const float v) -> unsigned int {
+      const uint32_t key = topKKey(v);
+      return (key & mask) == prefix ? (key >> shift) & 255 : 256;
+    }, &counts);
+    unsigned int digit = 255;
+    while (counts.data[digit] < needed) {
+      needed -= counts.data[digit];
+      --digit;
+    }
+    const bool whole = counts.data[digit] == needed;
+    delete[] counts.data;
+    prefix |= digit << shift;
+    mask |= 255u << shift;
+    if (whole) {
+      break;
+    }
+  }
+
+  const unsigned int workers = workerCount(size, 1 << 16);
+  std::vector<std::vector<TopKEntry>> above(workers), equal(workers);
+  parallelFor(workers, size, [&](const unsigned int worker, const size_t begin, const size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      const uint32_t key = topKKey(data[i]);
+      if ((key & mask) > prefix) {
+        above[worker].push_back({key, (uint32_t)i});
+      } else if ((key & mask) == prefix && equal[worker].size() < needed) {
+        equal[worker].push_back({key, (uint32_t)i});
+      }
+    }
+  });
+  result.clear();
+  result.reserve(k);
+  for (const std::vector<TopKEntry>& part : above) {
+    result.insert(result.end(), part.begin(), part.end());
+  }
+  for (const std::vector<TopKEntry>& part : equal) {
+    const size_t take = std::min(needed, part.size());
+    result.insert(result.end(), part.begin(), part.begin() + take);
+    needed -= take;
+  }
+  std::sort(result.begin(), result.end(), topKBefore);
+}
+
+void topKCPU(
+    const Mat2d<float>* input,
+    const unsigned int k,
+    Mat2d<float>* values,
+    Mat2d<uint32_t>* indices) {
+  const size_t size = (size_t)input->width * input->height;
+  if (k == 0 || k > size) {
+    std::cout << "k must be between 1 and the input size" << std::endl;
+    return;
+  }
+  std::vector<TopKEntry> result;
+  if (k <= TOP_K_HEAP_MAX) {
+    topKHeapCPU(input->data, size, k, result);
+  } else {
+    topKRadixCPU(input, k, result);
+  }
+  values->width = k;
+  values->height = 1;
+  values->data = new float[k];
+  indices->width = k;
+  indices->height = 1;
+  indices->data = new uint32_t[k];
+  for (unsigned int i = 0; i < k; ++i) {
+    values->data[i] = input->data[result[i].index];
+    indices->data[i] = result[i].index;
+  }
+}
+
+#endif // TOP_K_HPP